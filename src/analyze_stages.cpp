@@ -0,0 +1,24 @@
+#include <iostream>
+#include <string>
+
+#include "metrics/stage_tracer.h"
+
+
+static void
+usage(std::string prog)
+{
+    std::cout << "Usage: " << prog << " stage_trace\n";
+}
+
+int
+main(int argc, char const *argv[])
+{
+    if (argc < 2) {
+        usage(std::string(argv[0]));
+        exit(1);
+    }
+
+    metrics::analyze_stage_trace(argv[1], std::cout);
+
+    return 0;
+}
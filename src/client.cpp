@@ -1,13 +1,18 @@
 #include <arpa/inet.h>
+#include <atomic>
 #include <chrono>
+#include <deque>
 #include <event2/buffer.h>
 #include <event2/bufferevent.h>
 #include <event2/listener.h>
 #include <functional>
 #include <iostream>
+#include <iterator>
+#include <memory>
 #include <mutex>
 #include <netinet/tcp.h>
 #include <pthread.h>
+#include <random>
 #include <semaphore.h>
 #include <time.h>
 #include <tbb/concurrent_unordered_map.h>
@@ -20,73 +25,248 @@
 
 #include "constants/constants.h"
 #include "evclient/evclient.h"
+#include "metrics/latency_recorder.h"
 #include "request/request.hpp"
 #include "request/request_generation.h"
+#include "request/trace.h"
+#include "request/workload_generator.h"
 
 
 using toml_config = toml::basic_value<
 	toml::discard_comments, std::unordered_map, std::vector
 >;
 
+typedef std::chrono::steady_clock::time_point steady_time_point;
+
+static std::mutex report_mutex;  // keeps reports of client threads apart
+
+/*
+    OPEN_LOOP sends requests at a target arrival rate regardless of replies,
+    CLOSED_LOOP keeps a fixed window of outstanding requests.
+*/
+enum load_mode {OPEN_LOOP, CLOSED_LOOP};
+const std::unordered_map<std::string, load_mode> string_to_load_mode({
+    {"OPEN", OPEN_LOOP},
+    {"CLOSED", CLOSED_LOOP}
+});
+
+enum arrival_distribution {CONSTANT_ARRIVAL, POISSON_ARRIVAL};
+const std::unordered_map<std::string, arrival_distribution>
+    string_to_arrival_distribution({
+        {"CONSTANT", CONSTANT_ARRIVAL},
+        {"POISSON", POISSON_ARRIVAL}
+});
+
 struct dispatch_requests_args {
     client* c;
-    const std::vector<workload::Request>* requests;
-    int request_id, sleep_time, n_listener_threads;
+    const workload::Trace* requests;
+    workload::WorkloadGenerator* workload_generator;
+    int request_id, n_listener_threads;
+    int batch_size, n_batched_commands;
+    std::size_t batch_bytes;
+    struct event* flush_event;
+    struct timeval batch_timeout;
+
+    load_mode mode;
+    int outstanding;
+    // closed loop requests by send time, until their answer may be late
+    std::deque<std::pair<int, steady_time_point>> in_flight;
+    std::chrono::milliseconds request_timeout;
+    arrival_distribution distribution;
+    double arrival_rate;  // requests per second, 0 means unthrottled
+    std::mt19937 generator;
+    std::exponential_distribution<double> interarrival_time;
+    steady_time_point start_time, next_arrival;
+    struct event* tick_event;
+
+    int read_socket;  // -1 unless reads go to a read index holder
+    struct sockaddr_in read_index_addr;
 };
 
 
 static void
-send_request(evutil_socket_t fd, short event, void *arg)
+flush_batch(dispatch_requests_args* dispatch_args)
 {
-    auto* dispatch_args = (dispatch_requests_args *)arg;
-    auto* requests = (std::vector<workload::Request>*) dispatch_args->requests;
+    if (dispatch_args->n_batched_commands == 0) {
+        return;
+    }
+
     auto* c = dispatch_args->c;
-    auto requests_id = dispatch_args->request_id;
-    auto sleep_time = dispatch_args->sleep_time;
-    auto n_listener_threads = dispatch_args->n_listener_threads;
+    encode_batch_header(dispatch_args->n_batched_commands, c->send_buffer);
+    paxos_submit(c->bev, c->send_buffer, dispatch_args->batch_bytes);
 
-    auto* client_args = (struct client_args *) c->args;
-	auto* v = (struct client_message*)c->send_buffer;
+    dispatch_args->n_batched_commands = 0;
+    dispatch_args->batch_bytes = sizeof(struct batch_header);
+    evtimer_del(dispatch_args->flush_event);
+}
+
+static void
+on_batch_timeout(evutil_socket_t fd, short event, void *arg)
+{
+    flush_batch((dispatch_requests_args *)arg);
+}
 
-    auto request = requests->at(requests_id);
-    v->sin_port = htons(
-        client_args->reply_port + (requests_id % n_listener_threads)
+static void
+submit_command(
+    dispatch_requests_args* dispatch_args, const struct command& command)
+{
+    // commands are appended to the pending batch, which is submitted
+    // as a single Paxos value once full or once its timeout expires
+    auto* c = dispatch_args->c;
+    dispatch_args->batch_bytes += encode_command(
+        command, c->send_buffer + dispatch_args->batch_bytes
     );
-    v->id = requests_id;
-    v->type = request.type();
-    v->key = request.key();
-    if (request.type() == WRITE and request.args().empty()) {
-        memset(v->args, '#', VALUE_SIZE);
-        v->args[VALUE_SIZE-1] = '\0';
-        v->size = VALUE_SIZE;
+    dispatch_args->n_batched_commands++;
+
+    if (dispatch_args->n_batched_commands == dispatch_args->batch_size) {
+        flush_batch(dispatch_args);
+    } else if (dispatch_args->n_batched_commands == 1) {
+        evtimer_add(dispatch_args->flush_event, &dispatch_args->batch_timeout);
     }
-    else {
-        for (auto i = 0; i < request.args().size(); i++) {
-            v->args[i] = request.args()[i];
-        }
-        v->args[request.args().size()] = 0;
-        v->size = request.args().size();
+}
+
+// reads bypass batching, the read index holder orders and answers them
+static void
+send_local_read(
+    dispatch_requests_args* dispatch_args, const struct command& command)
+{
+    char value[sizeof(struct batch_header) + MAX_ENCODED_COMMAND_SIZE];
+    auto size = encode_batch_header(1, value);
+    size += encode_command(command, value + size);
+    auto n_bytes = sendto(
+        dispatch_args->read_socket, value, size, 0,
+        (const struct sockaddr *) &dispatch_args->read_index_addr,
+        sizeof(dispatch_args->read_index_addr)
+    );
+    if (n_bytes < 0) {
+        printf("Failed to send read to the read index holder\n");
     }
+}
 
-    auto size = sizeof(struct client_message) + v->size;
-    auto timestamp = std::chrono::system_clock::now();
-    auto kv = std::make_pair(v->id, timestamp);
-    client_args->sent_timestamp->insert(kv);
-    paxos_submit(c->bev, c->send_buffer, size);
-    requests_id++;
+static void
+send_request(
+    dispatch_requests_args* dispatch_args, int request_id,
+    int64_t timestamp_ns)
+{
+    auto* c = dispatch_args->c;
+    auto n_listener_threads = dispatch_args->n_listener_threads;
+    auto* client_args = (struct client_args *) c->args;
 
-    if (requests_id != requests->size()) {
-        dispatch_args->request_id++;
-	auto sleepy = (struct timespec){0, sleep_time};
-	nanosleep(&sleepy, &sleepy);
+    // generated workloads are streamed, traces are read in place
+    workload::trace_record request;
+    const char* value = nullptr;
+    if (dispatch_args->workload_generator != nullptr) {
+        dispatch_args->workload_generator->next(request);
+    } else {
+        request = (*dispatch_args->requests)[request_id];
+        value = dispatch_args->requests->value(request_id);
+    }
 
+    struct command command;
+    workload::fill_command(request, request_id, command, value);
+    command.s_addr = client_args->reply_address;
+    command.sin_port = htons(
+        client_args->reply_port + (request_id % n_listener_threads)
+    );
 
-        auto time = (struct timeval){0, 0};
-        auto send_event = evtimer_new(
-            c->base, send_request, dispatch_args
+    if (client_args->latency_recorder->sent(command.id, timestamp_ns)) {
+        client_args->n_outstanding--;
+    }
+    client_args->n_outstanding++;
+    if (dispatch_args->mode == CLOSED_LOOP) {
+        dispatch_args->in_flight.emplace_back(
+            command.id, std::chrono::steady_clock::now()
         );
-        event_add(send_event, &time);
+    }
+    auto type = static_cast<request_type>(command.type);
+    if (dispatch_args->read_socket >= 0 and (type == READ or type == SCAN)) {
+        send_local_read(dispatch_args, command);
     } else {
+        submit_command(dispatch_args, command);
+    }
+}
+
+static std::chrono::nanoseconds
+next_interarrival_time(dispatch_requests_args* dispatch_args)
+{
+    double seconds;
+    if (dispatch_args->distribution == POISSON_ARRIVAL) {
+        seconds = dispatch_args->interarrival_time(dispatch_args->generator);
+    } else {
+        seconds = 1.0 / dispatch_args->arrival_rate;
+    }
+    return std::chrono::nanoseconds((long) (seconds * 1e9));
+}
+
+// gives up on requests unanswered for request_timeout, so that a lost
+// answer doesn't hold its place in the closed loop window forever
+static void
+expire_requests(dispatch_requests_args* dispatch_args, steady_time_point now)
+{
+    auto* client_args = (struct client_args *) dispatch_args->c->args;
+    auto& in_flight = dispatch_args->in_flight;
+    while (not in_flight.empty() and
+           now - in_flight.front().second >= dispatch_args->request_timeout)
+    {
+        if (client_args->latency_recorder->expire(in_flight.front().first)) {
+            client_args->n_outstanding--;
+        }
+        in_flight.pop_front();
+    }
+}
+
+static void
+send_requests(evutil_socket_t fd, short event, void *arg)
+{
+    // A single persistent timer drives the load. Each tick sends every
+    // request whose arrival time has passed (open loop) or refills the
+    // window of outstanding requests (closed loop).
+    auto* dispatch_args = (dispatch_requests_args *)arg;
+    auto* c = dispatch_args->c;
+    auto* client_args = (struct client_args *) c->args;
+    auto n_requests = dispatch_args->workload_generator != nullptr ?
+        dispatch_args->workload_generator->size() :
+        dispatch_args->requests->size();
+
+    auto now = std::chrono::steady_clock::now();
+    if (now < dispatch_args->start_time) {
+        return;
+    }
+
+    auto& request_id = dispatch_args->request_id;
+    if (dispatch_args->mode == CLOSED_LOOP) {
+        expire_requests(dispatch_args, now);
+        while (request_id < n_requests and
+               client_args->n_outstanding < dispatch_args->outstanding)
+        {
+            send_request(dispatch_args, request_id, workload::now_ns());
+            request_id++;
+        }
+    } else if (dispatch_args->arrival_rate <= 0) {
+        if (request_id < n_requests) {
+            send_request(dispatch_args, request_id, workload::now_ns());
+            request_id++;
+        }
+    } else {
+        // latency is measured from the intended arrival time, so a late
+        // tick doesn't hide the time requests spent waiting to be sent
+        auto& next_arrival = dispatch_args->next_arrival;
+        while (request_id < n_requests and next_arrival <= now) {
+            auto arrival_ns = std::chrono::duration_cast<
+                std::chrono::nanoseconds
+            >(next_arrival.time_since_epoch()).count();
+            send_request(dispatch_args, request_id, arrival_ns);
+            request_id++;
+            next_arrival += next_interarrival_time(dispatch_args);
+        }
+    }
+
+    if (request_id >= n_requests) {
+        flush_batch(dispatch_args);
+        event_del(dispatch_args->tick_event);
+        if (dispatch_args->read_socket >= 0) {
+            close(dispatch_args->read_socket);
+        }
         event_base_loopexit(c->base, NULL);
     }
 }
@@ -95,25 +275,58 @@ static void
 read_reply(const struct reply_message& reply, void* args)
 {
     auto* client_args = (struct client_args *) args;
-    auto* sent_timestamp = client_args->sent_timestamp;
-    auto* print_mutex = client_args->print_mutex;
-
-    if (client_args->print_percentage >= rand() % 100 + 1) {
-        auto now = std::chrono::system_clock::now();
-        auto delay_ns = now - sent_timestamp->at(reply.id);
-
-        std::lock_guard<std::mutex> lock(*print_mutex);
-        if (client_args->verbose) {
-            std::cout << "Request " << reply.id << "; ";
-            std::cout << "He said " << reply.answer << "; ";
-            std::cout << "Delay " << delay_ns.count() << ";\n";
+    auto listener_id = reply.id % client_args->n_listener_threads;
+    auto latency = client_args->latency_recorder->answered(
+        listener_id, reply.id, reply.type, workload::now_ns()
+    );
+    // answers to expired requests no longer hold a place in the window
+    if (latency >= 0) {
+        client_args->n_outstanding--;
+        if (client_args->send_event != nullptr) {
+            event_active(client_args->send_event, EV_TIMEOUT, 1);
+        }
+    }
+
+    if (client_args->verbose and
+        client_args->print_percentage >= rand() % 100 + 1)
+    {
+        std::lock_guard<std::mutex> lock(*client_args->print_mutex);
+        std::cout << "Request " << reply.id << "; ";
+        std::cout << "He said ";
+        if (reply.type == SCAN) {
+            auto values = scan_answer_values(reply.answer, reply.size);
+            std::copy(
+                values.begin(), values.end(),
+                std::ostream_iterator<std::string>(std::cout, ",")
+            );
         } else {
-            std::cout << now.time_since_epoch().count() << ",";
-            std::cout << delay_ns.count() << "\n";
+            std::cout << reply.answer;
         }
+        std::cout << "; ";
+        std::cout << "Delay " << latency << ";\n";
     }
 }
 
+static void
+report_latencies(
+    metrics::LatencyRecorder* latency_recorder, int interval_ms,
+    std::atomic<bool>& reporting)
+{
+    while (reporting) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+        auto epoch = std::chrono::system_clock::now().time_since_epoch();
+        std::lock_guard<std::mutex> lock(report_mutex);
+        latency_recorder->report(std::cout, epoch.count());
+    }
+}
+
+static int
+batch_size(const toml_config& config)
+{
+    auto size = toml::find_or(config, "batch_size", 1);
+    return std::max(1, std::min<int>(size, MAX_BATCH_SIZE));
+}
+
 static struct client*
 make_ev_client(const toml_config& config)
 {
@@ -123,8 +336,10 @@ make_ev_client(const toml_config& config)
     auto proposer_id = toml::find<int>(
         config, "proposer_id"
     );
+    auto outstanding = toml::find_or(config, "outstanding", OUTSTANDING);
     auto* client = make_client(
-        paxos_config.c_str(), proposer_id, OUTSTANDING, VALUE_SIZE,
+        paxos_config.c_str(), proposer_id, outstanding,
+        batch_buffer_size(batch_size(config)),
         nullptr, read_reply
     );
 	signal(SIGPIPE, SIG_IGN);
@@ -132,7 +347,9 @@ make_ev_client(const toml_config& config)
 }
 
 static struct client_args*
-make_client_args(const toml_config& config, unsigned short port, bool verbose)
+make_client_args(
+    const toml_config& config, unsigned short port, int n_listener_threads,
+    bool verbose)
 {
     auto* client_args = new struct client_args();
     client_args->verbose = verbose;
@@ -140,9 +357,16 @@ make_client_args(const toml_config& config, unsigned short port, bool verbose)
         config, "print_percentage"
     );
     client_args->reply_port = port;
-    auto* sent_timestamp = new tbb::concurrent_unordered_map<int, time_point>();
+    auto reply_address = toml::find_or(
+        config, "reply_address", std::string("0.0.0.0")
+    );
+    client_args->reply_address = inet_addr(reply_address.c_str());
+    client_args->n_listener_threads = n_listener_threads;
+    auto latency_ring_size = toml::find_or(config, "latency_ring_size", 1 << 20);
+    client_args->latency_recorder = new metrics::LatencyRecorder(
+        n_listener_threads, latency_ring_size
+    );
     auto* print_mutex = new std::mutex();
-    client_args->sent_timestamp = sent_timestamp;
     client_args->print_mutex = print_mutex;
     return client_args;
 }
@@ -151,7 +375,7 @@ static void
 free_client_args(struct client_args* client_args)
 {
     delete client_args->print_mutex;
-    delete client_args->sent_timestamp;
+    delete client_args->latency_recorder;
     delete client_args;
 }
 
@@ -160,55 +384,129 @@ schedule_send_requests_event(
     struct client* client,
     pthread_barrier_t& start_barrier,
     int n_listener_threads,
-    const std::vector<workload::Request>& requests,
+    const workload::Trace& requests,
+    workload::WorkloadGenerator* workload_generator,
     const toml_config& config)
 {
-    auto sleep_time = toml::find<int>(
-        config, "sleep_time"
-    );
-
     auto* dispatch_args = new struct dispatch_requests_args();
     dispatch_args->c = client;
     dispatch_args->requests = &requests;
+    dispatch_args->workload_generator = workload_generator;
     dispatch_args->request_id = 0;
-    dispatch_args->sleep_time = sleep_time;
     dispatch_args->n_listener_threads = n_listener_threads;
+    dispatch_args->batch_size = batch_size(config);
+    dispatch_args->n_batched_commands = 0;
+    dispatch_args->batch_bytes = sizeof(struct batch_header);
+    auto batch_timeout = toml::find_or(config, "batch_timeout", 100);
+    dispatch_args->batch_timeout = (struct timeval){
+        batch_timeout / 1000000, batch_timeout % 1000000
+    };
+    dispatch_args->flush_event = evtimer_new(
+        client->base, on_batch_timeout, dispatch_args
+    );
 
-	auto time = (struct timeval){1, 0};
-	auto send_event = evtimer_new(
-        client->base, send_request, dispatch_args
+    dispatch_args->read_socket = -1;
+    auto read_index_port = toml::find_or(config, "read_index_port", 0);
+    if (toml::find_or(config, "read_index_replica", -1) >= 0 and
+        read_index_port > 0)
+    {
+        auto read_index_address = toml::find_or(
+            config, "read_index_address", std::string("127.0.0.1")
+        );
+        dispatch_args->read_socket = socket(AF_INET, SOCK_DGRAM, 0);
+        memset(&dispatch_args->read_index_addr, 0, sizeof(sockaddr_in));
+        dispatch_args->read_index_addr.sin_family = AF_INET;
+        dispatch_args->read_index_addr.sin_addr.s_addr = inet_addr(
+            read_index_address.c_str()
+        );
+        dispatch_args->read_index_addr.sin_port = htons(read_index_port);
+    }
+
+    // sleep_time, the delay between requests in nanoseconds, is kept as
+    // the default open loop rate so older configurations behave the same
+    auto mode = toml::find_or(config, "load_mode", std::string("OPEN"));
+    dispatch_args->mode = string_to_load_mode.at(mode);
+    dispatch_args->outstanding = client->outstanding;
+    dispatch_args->request_timeout = std::chrono::milliseconds(
+        toml::find_or(config, "request_timeout", 1000)
+    );
+    auto distribution = toml::find_or(
+        config, "arrival_distribution", std::string("CONSTANT")
+    );
+    dispatch_args->distribution = string_to_arrival_distribution.at(
+        distribution
+    );
+    auto sleep_time = toml::find_or(config, "sleep_time", 0);
+    auto default_rate = sleep_time > 0 ? 1e9 / sleep_time : 0.0;
+    dispatch_args->arrival_rate = toml::find_or(
+        config, "arrival_rate", default_rate
     );
-	event_add(send_event, &time);
+    dispatch_args->generator = std::mt19937(std::random_device()());
+    if (dispatch_args->arrival_rate > 0) {
+        dispatch_args->interarrival_time =
+            std::exponential_distribution<double>(dispatch_args->arrival_rate);
+    }
+
+    dispatch_args->start_time =
+        std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    dispatch_args->next_arrival = dispatch_args->start_time;
+
+    // unthrottled open loop ticks on every loop iteration, other modes
+    // wake up at tick_interval microseconds
+    auto tick_interval = toml::find_or(config, "tick_interval", 50);
+    if (dispatch_args->mode == OPEN_LOOP and dispatch_args->arrival_rate <= 0) {
+        tick_interval = 0;
+    }
+    auto tick = (struct timeval){
+        tick_interval / 1000000, tick_interval % 1000000
+    };
+    dispatch_args->tick_event = event_new(
+        client->base, -1, EV_PERSIST, send_requests, dispatch_args
+    );
+    event_add(dispatch_args->tick_event, &tick);
+
+    auto* client_args = (struct client_args *) client->args;
+    if (dispatch_args->mode == CLOSED_LOOP) {
+        client_args->send_event = dispatch_args->tick_event;
+    }
 }
 
 static void
 start_client(const toml_config& config, 
-             const std::vector<workload::Request>& requests,
+             const workload::Trace& requests,
              unsigned short port,
              bool verbose) {
 
-    auto* client = make_ev_client(config);
-    client->args = make_client_args(config, port, verbose);
-
     auto n_listener_threads = toml::find<int>(
         config, "n_threads"
     );
-    auto n_total_requests = toml::find<int>(
-        config, "n_requests"
+    auto* client = make_ev_client(config);
+    client->args = make_client_args(
+        config, port, n_listener_threads, verbose
     );
+    auto* client_args = (struct client_args *) client->args;
+
+    std::unique_ptr<workload::WorkloadGenerator> workload_generator;
+    if (config.contains("workload")) {
+        workload_generator.reset(new workload::WorkloadGenerator(
+            workload::make_workload_generator(config, port)
+        ));
+    }
+    // listeners wait for answers to the requests actually sent
+    int n_total_requests = workload_generator ?
+        workload_generator->size() : requests.size();
 
     pthread_barrier_t start_barrier;
     pthread_barrier_init(&start_barrier, NULL, n_listener_threads+1);
 
     std::vector<std::thread> listener_threads;
-    int n_answered_requests = 0;
-    std::mutex n_answered_requests_mutex;
+    std::vector<answer_counter> n_answered_requests(n_listener_threads);
     for (auto i = 0; i < n_listener_threads; i++) {
         listener_threads.emplace_back(
             listen_server, 
             client,
             std::ref(n_answered_requests),
-            std::ref(n_answered_requests_mutex),
+            i,
             n_total_requests,
             port+i,
             std::ref(start_barrier)
@@ -219,14 +517,34 @@ start_client(const toml_config& config,
     std::cout << "All listeners ready" << std::endl;
 
 
+    std::atomic<bool> reporting{true};
+    auto report_interval = toml::find_or(config, "report_interval", 1000);
+    std::thread reporter_thread(
+        report_latencies, client_args->latency_recorder, report_interval,
+        std::ref(reporting)
+    );
+
     schedule_send_requests_event(
-        client, start_barrier, n_listener_threads, requests, config
+        client, start_barrier, n_listener_threads, requests,
+        workload_generator.get(), config
     );
 	event_base_loop(client->base, EVLOOP_NO_EXIT_ON_EMPTY);
 
     for (auto& thread: listener_threads) {
         thread.join();
     }
+    reporting = false;
+    reporter_thread.join();
+    {
+        std::lock_guard<std::mutex> lock(report_mutex);
+        auto epoch = std::chrono::system_clock::now().time_since_epoch();
+        client_args->latency_recorder->report(std::cout, epoch.count());
+        client_args->latency_recorder->report_total(std::cout);
+        auto n_expired = client_args->latency_recorder->n_expired();
+        if (n_expired > 0) {
+            std::cout << n_expired << " requests expired unanswered\n";
+        }
+    }
 
     free_client_args((struct client_args *)client->args);
     client_free(client);
@@ -252,10 +570,15 @@ int main(int argc, char* argv[]) {
     }
     srand (time(NULL));
 
-    auto requests_path = toml::find<std::string>(
-        config, "requests_path"
-    );
-    auto requests = workload::import_cs_requests(requests_path);
+    // a [workload] table makes every client thread generate its own
+    // requests instead of reading them from requests_path
+    workload::Trace requests;
+    if (not config.contains("workload")) {
+        auto requests_path = toml::find<std::string>(
+            config, "requests_path"
+        );
+        requests = workload::Trace::load(requests_path);
+    }
     auto n_dispatchers_threads = toml::find<int>(
         config, "n_dispatchers_threads"
     );
@@ -12,6 +12,12 @@
   * the binary data. */
 std::string compress(const std::string& str,
                             int compressionlevel/* = Z_BEST_COMPRESSION*/)
+{
+    return compress(str.data(), str.size(), compressionlevel);
+}
+
+std::string compress(const char* data, std::size_t size,
+                            int compressionlevel/* = Z_BEST_COMPRESSION*/)
 {
     z_stream zs;                        // z_stream is zlib's control structure
     memset(&zs, 0, sizeof(zs));
@@ -19,8 +25,8 @@ std::string compress(const std::string& str,
     if (deflateInit(&zs, compressionlevel) != Z_OK)
         throw(std::runtime_error("deflateInit failed while compressing."));
 
-    zs.next_in = (Bytef*)str.data();
-    zs.avail_in = str.size();           // set the z_stream's input
+    zs.next_in = (Bytef*)data;
+    zs.avail_in = size;                 // set the z_stream's input
 
     int ret;
     char outbuffer[VALUE_SIZE];
@@ -92,3 +98,36 @@ std::string decompress(const std::string& str)
 
     return outstring;
 }
+
+/** Decompress an STL string using zlib straight into buffer, which must be
+  * able to hold the whole original data. Return the number of bytes
+  * written. */
+std::size_t decompress(const std::string& str, char* buffer,
+                       std::size_t capacity)
+{
+    z_stream zs;                        // z_stream is zlib's control structure
+    memset(&zs, 0, sizeof(zs));
+
+    if (inflateInit(&zs) != Z_OK)
+        throw(std::runtime_error("inflateInit failed while decompressing."));
+
+    zs.next_in = (Bytef*)str.data();
+    zs.avail_in = str.size();
+    zs.next_out = reinterpret_cast<Bytef*>(buffer);
+    zs.avail_out = capacity;
+
+    // the whole output fits in buffer, so a single call must reach the end
+    auto ret = inflate(&zs, Z_FINISH);
+    auto n_bytes = zs.total_out;
+
+    inflateEnd(&zs);
+
+    if (ret != Z_STREAM_END) {          // an error occurred or buffer is full
+        std::ostringstream oss;
+        oss << "Exception during zlib decompression: (" << ret << ") "
+            << (zs.msg != nullptr ? zs.msg : "output buffer too small");
+        throw(std::runtime_error(oss.str()));
+    }
+
+    return n_bytes;
+}
@@ -23,7 +23,17 @@
 std::string compress(const std::string& str,
                             int compressionlevel = Z_BEST_COMPRESSION);
 
+/** Compress size bytes of data, for callers that don't hold a string. */
+std::string compress(const char* data, std::size_t size,
+                            int compressionlevel = Z_BEST_COMPRESSION);
+
 /** Decompress an STL string using zlib and return the original data. */
 std::string decompress(const std::string& str);
 
+/** Decompress an STL string using zlib straight into buffer, which must be
+  * able to hold the whole original data. Return the number of bytes
+  * written. */
+std::size_t decompress(const std::string& str, char* buffer,
+                       std::size_t capacity);
+
 #endif
@@ -4,6 +4,9 @@
 const int VALUE_SIZE = 128;
 const int MAX_SCAN_LENGTH = 8;
 const int OUTSTANDING = 1;
+const int VALUE_CACHE_SIZE = 1024;  // decompressed values cached per partition
+const int DELIVERY_QUEUE_SIZE = 4096;  // Paxos values waiting to be scheduled
+const int DISPATCH_WINDOW = 256;  // values planned ahead of the scheduler
 
 
 #endif
@@ -0,0 +1,33 @@
+#include <iostream>
+#include <string>
+
+#include "request/request_generation.h"
+#include "request/trace.h"
+
+
+static void
+usage(std::string prog)
+{
+    std::cout << "Usage: " << prog << " requests.csv output_trace\n";
+}
+
+int
+main(int argc, char const *argv[])
+{
+    if (argc < 3) {
+        usage(std::string(argv[0]));
+        exit(1);
+    }
+
+    // requests are streamed from one file to the other, so traces
+    // larger than memory can be converted
+    workload::TraceWriter writer(argv[2]);
+    workload::for_each_cs_request(argv[1],
+        [&writer](request_type type, int key, const char* args) {
+            writer.write(workload::make_trace_record(type, key, args));
+        }
+    );
+    writer.close();
+
+    return 0;
+}
@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <toml11/toml.hpp>
+#include "graph/graph.hpp"
+#include "graph/partitioning.h"
+#include "request/trace.h"
+#include "request/workload_generator.h"
+#include "scheduler/key_mapping.hpp"
+#include "scheduler/partition_set.h"
+#include "scheduler/pattern_tracker.hpp"
+#include "types/types.h"
+
+
+const std::vector<std::string> ALL_CUT_METHODS{
+    "METIS", "KAHIP", "FENNEL", "REFENNEL", "REFENNEL2", "RANGE"
+};
+
+/*
+    Replays requests through the same key mapping as the Scheduler, and
+    every repartition_interval dispatched requests cuts the tracker's graph
+    again, without executing them.
+*/
+class PartitioningEvaluator {
+public:
+    PartitioningEvaluator(int n_partitions, model::CutMethod method)
+        : n_partitions_{n_partitions},
+          method_{method},
+          tracker_(n_partitions),
+          key_mapping_(n_partitions, method),
+          accesses_(n_partitions, 0)
+    {
+        if (n_partitions < 1 or
+            n_partitions > kvpaxos::PartitionSet::MAX_PARTITIONS)
+        {
+            throw std::invalid_argument(
+                "Number of partitions must be between 1 and " +
+                std::to_string(kvpaxos::PartitionSet::MAX_PARTITIONS)
+            );
+        }
+    }
+
+    void populate_n_initial_keys(int n_keys) {
+        key_mapping_.populate_n_initial_keys(n_keys);
+        tracker_.populate_n_sequential_vertices(n_keys);
+    }
+
+    // whether the Scheduler would dispatch the request, and count it
+    // toward its repartition interval
+    bool replay(struct command& request) {
+        if (request.type == WRITE and not key_mapping_.mapped(request.key)) {
+            key_mapping_.add_key(request.key);
+        }
+
+        auto partitions = key_mapping_.involved_partitions(request);
+        if (partitions.empty()) {
+            return false;
+        }
+        n_requests_++;
+        if (partitions.size() > 1) {
+            n_cross_partition_requests_++;
+        }
+        for (auto partition : partitions) {
+            accesses_[partition]++;
+        }
+        tracker_.update_workload_graph(request);
+        tracker_.register_access(partitions);
+        return true;
+    }
+
+    // prints the interval that just ended and the repartition ending it
+    void repartition_and_report(
+        const std::string& label, int interval_index, std::ostream& out)
+    {
+        auto total_accesses = 0;
+        for (auto accesses : accesses_) {
+            total_accesses += accesses;
+        }
+        auto imbalance = total_accesses == 0 ? 0.0 :
+            double(*std::max_element(accesses_.begin(), accesses_.end())) /
+            (double(total_accesses) / n_partitions_);
+        auto cross_partition_ratio = n_requests_ == 0 ? 0.0 :
+            double(n_cross_partition_requests_) / n_requests_;
+
+        auto start = std::chrono::steady_clock::now();
+        auto keys_moved = repartition();
+        auto cut_ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start
+        ).count();
+
+        out << label << "," << interval_index << ",";
+        out << cross_partition_ratio << "," << imbalance << ",";
+        out << edge_cut() << "," << keys_moved << "," << cut_ms << "\n";
+
+        n_requests_ = 0;
+        n_cross_partition_requests_ = 0;
+        std::fill(accesses_.begin(), accesses_.end(), 0);
+    }
+
+private:
+    int64_t repartition() {
+        const auto& graph = tracker_.workload_graph();
+        auto accesses_per_partition = tracker_.accesses_per_partition();
+        auto partition_scheme = model::cut_graph(
+            graph, key_mapping_.data_to_partition_id(),
+            accesses_per_partition, method_
+        );
+
+        auto sorted_vertex = graph.sorted_vertex();
+        auto keys_moved = key_mapping_.assign(sorted_vertex, partition_scheme);
+        tracker_.reset_accesses();
+        for (auto i = 0; i < partition_scheme.size(); i++) {
+            tracker_.register_accesses_to_partition(
+                partition_scheme[i], graph.vertice_weight(sorted_vertex[i])
+            );
+        }
+        return keys_moved;
+    }
+
+    // fraction of the graph's edge weight between different partitions
+    double edge_cut() {
+        const auto& graph = tracker_.workload_graph();
+        long cut_weight = 0, total_weight = 0;
+        for (const auto& vertice : graph.vertex()) {
+            auto from = vertice.first;
+            for (const auto& edge : graph.vertice_edges(from)) {
+                if (edge.first <= from) {
+                    continue;
+                }
+                total_weight += edge.second;
+                if (key_mapping_.partition(from) !=
+                    key_mapping_.partition(edge.first))
+                {
+                    cut_weight += edge.second;
+                }
+            }
+        }
+
+        // ranges count once for every pair of neighbouring keys they split
+        auto sorted_vertex = graph.sorted_vertex();
+        auto path_weights = graph.path_weights(sorted_vertex);
+        for (auto i = 0; i + 1 < sorted_vertex.size(); i++) {
+            if (sorted_vertex[i+1] != sorted_vertex[i] + 1) {
+                continue;
+            }
+            total_weight += path_weights[i];
+            if (key_mapping_.partition(sorted_vertex[i]) !=
+                key_mapping_.partition(sorted_vertex[i+1]))
+            {
+                cut_weight += path_weights[i];
+            }
+        }
+        return total_weight == 0 ? 0.0 : double(cut_weight) / total_weight;
+    }
+
+    int n_partitions_;
+    model::CutMethod method_;
+    kvpaxos::PatternTracker<int> tracker_;
+    kvpaxos::KeyMapping<int> key_mapping_;
+
+    int n_requests_ = 0;
+    int n_cross_partition_requests_ = 0;
+    std::vector<int> accesses_;
+};
+
+static void
+usage(std::string prog)
+{
+    std::cout << "Usage: " << prog << " config\n";
+}
+
+int
+main(int argc, char const *argv[])
+{
+    if (argc < 2) {
+        usage(std::string(argv[0]));
+        exit(1);
+    }
+
+    const auto config = toml::parse(argv[1]);
+    auto requests = workload::load_requests(config);
+    auto n_initial_keys = toml::find<int>(config, "n_initial_keys");
+    auto n_partitions = toml::find<int>(config, "n_partitions");
+    auto methods = toml::find_or(config, "evaluate_methods", ALL_CUT_METHODS);
+    auto intervals = toml::find_or(
+        config, "evaluate_intervals",
+        std::vector<int>{toml::find<int>(config, "repartition_interval")}
+    );
+
+    std::cout << "METHOD,REPARTITION_INTERVAL,INTERVAL,CROSS_PARTITION_RATIO,";
+    std::cout << "IMBALANCE,EDGE_CUT,KEYS_MOVED,CUT_MS\n";
+    for (const auto& method : methods) {
+        for (auto interval : intervals) {
+            model::FIRST_REPARTITION = true;
+            PartitioningEvaluator evaluator(
+                n_partitions, model::string_to_cut_method.at(method)
+            );
+            evaluator.populate_n_initial_keys(n_initial_keys);
+
+            auto label = method + "," + std::to_string(interval);
+            auto n_dispatched = 0;
+            for (auto i = 0; i < requests.size(); i++) {
+                struct command request;
+                workload::fill_command(requests[i], i, request);
+                if (not evaluator.replay(request)) {
+                    continue;
+                }
+                n_dispatched++;
+                if (n_dispatched % interval == 0) {
+                    evaluator.repartition_and_report(
+                        label, n_dispatched / interval - 1, std::cout
+                    );
+                }
+            }
+        }
+    }
+
+    return 0;
+}
@@ -44,12 +44,22 @@ connect_to_proposer(
 	return bev;
 }
 
+static int
+total_answered_requests(const std::vector<answer_counter>& n_answered_requests)
+{
+	auto total = 0;
+	for (const auto& counter : n_answered_requests) {
+		total += counter.value.load(std::memory_order_relaxed);
+	}
+	return total;
+}
+
 void
 listen_server(
-	struct client* client, 
-	int& n_answered_requests,
-	std::mutex& requests_counter_mutex,
-	int n_total_requests, 
+	struct client* client,
+	std::vector<answer_counter>& n_answered_requests,
+	int listener_id,
+	int n_total_requests,
 	unsigned short port,
 	pthread_barrier_t& start_barrier
 ) {
@@ -75,32 +85,63 @@ listen_server(
 	timeout.tv_usec = 0;
 	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
 
-	std::unordered_set<int> answered_requests;
+	std::vector<struct reply_message> replies(LISTENER_BATCH_SIZE);
+	std::vector<struct iovec> buffers(LISTENER_BATCH_SIZE);
+	std::vector<struct mmsghdr> messages(LISTENER_BATCH_SIZE);
+	for (auto i = 0; i < LISTENER_BATCH_SIZE; i++) {
+		buffers[i].iov_base = &replies[i];
+		buffers[i].iov_len = sizeof(struct reply_message);
+		memset(&messages[i], 0, sizeof(struct mmsghdr));
+		messages[i].msg_hdr.msg_iov = &buffers[i];
+		messages[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	// requests are spread among listeners by id, so each listener only
+	// tracks every n_listener_threads-th id
+	int n_listener_threads = n_answered_requests.size();
+	std::vector<uint64_t> answered_requests(
+		n_total_requests / n_listener_threads / 64 + 1, 0
+	);
+	auto& n_answered = n_answered_requests[listener_id].value;
+
 	pthread_barrier_wait(&start_barrier);
 	while (RUNNING) {
-		struct reply_message reply;
-		auto n_bytes = recv(fd, &reply, sizeof(reply_message), 0);
-		if (n_bytes == -1) {
-			if (n_answered_requests == n_total_requests) {
+		auto n_messages = recvmmsg(
+			fd, messages.data(), LISTENER_BATCH_SIZE, MSG_WAITFORONE, NULL
+		);
+		if (n_messages == -1) {
+			auto n_answers = total_answered_requests(n_answered_requests);
+			if (n_answers == n_total_requests) {
 				break;
-			} else if(n_answered_requests >= 99*n_total_requests/100) {
+			} else if(n_answers >= 99*n_total_requests/100) {
 				break;
 			}
 			continue;
 		}
 
-		if (answered_requests.find(reply.id) != answered_requests.end()) {
-			continue;
-		}
+		for (auto i = 0; i < n_messages; i++) {
+			const auto& reply = replies[i];
+			if (messages[i].msg_len < offsetof(struct reply_message, answer)) {
+				continue;
+			}
 
-		{
-			std::scoped_lock lock(requests_counter_mutex);
-			n_answered_requests++;
-		}
+			// the same answer arrives from every replica
+			std::size_t index = reply.id / n_listener_threads;
+			auto word = index / 64;
+			auto bit = uint64_t(1) << (index % 64);
+			if (word >= answered_requests.size()) {
+				answered_requests.resize(word + 1, 0);
+			}
+			if (answered_requests[word] & bit) {
+				continue;
+			}
+			answered_requests[word] |= bit;
 
-		client->reply_cb(reply, client->args);
-		answered_requests.insert(reply.id);
+			n_answered.fetch_add(1, std::memory_order_relaxed);
+			client->reply_cb(reply, client->args);
+		}
 	}
+	close(fd);
 }
 
 struct client*
@@ -112,6 +153,9 @@ make_client(
 {
 	struct client* c;
 	c = (struct client*)malloc(sizeof(struct client));
+	// listener threads wake the sending event up, so the base must be
+	// created after enabling libevent's locking
+	evthread_use_pthreads();
 	c->base = event_base_new();
 
 	memset(&c->stats, 0, sizeof(struct stats));
@@ -123,7 +167,7 @@ make_client(
 	c->id = rand();
 	c->value_size = value_size;
 	c->outstanding = outstanding;
-	c->send_buffer = (char *)malloc(sizeof(client_message) + value_size);
+	c->send_buffer = (char *)malloc(value_size);
 	c->reply_cb = on_reply;
 	c->sent_requests_timestamp = new std::unordered_map<
 		int, std::chrono::_V2::system_clock::time_point
@@ -12,14 +12,23 @@
 #include <pthread.h>
 #include <string.h>
 #include <signal.h>
-#include <mutex>
+#include <atomic>
 #include <netinet/tcp.h>
 #include <unordered_map>
-#include <unordered_set>
+#include <vector>
 
 #include "types/types.h"
 
 
+// maximum number of replies a listener takes from its socket at once
+const int LISTENER_BATCH_SIZE = 64;
+
+// answers counted by a single listener thread, aligned so that listeners
+// don't write to the same cache line
+struct alignas(64) answer_counter {
+	std::atomic<int> value{0};
+};
+
 struct client* make_client(
     const char* config, int proposer_id, int outstanding,
 	int value_size, bufferevent_event_cb on_connect,
@@ -27,9 +36,9 @@ struct client* make_client(
 );
 void listen_server(
 	struct client* client, 
-	int& n_answered_requests,
-	std::mutex& requests_counter_mutex,
-	int n_total_requests, 
+	std::vector<answer_counter>& n_answered_requests,
+	int listener_id,
+	int n_total_requests,
 	unsigned short port,
 	pthread_barrier_t& start_barrier
 );
@@ -0,0 +1,34 @@
+#include <iostream>
+#include <string>
+
+#include <toml11/toml.hpp>
+#include "request/trace.h"
+#include "request/workload_generator.h"
+
+
+static void
+usage(std::string prog)
+{
+    std::cout << "Usage: " << prog << " config.toml output_trace\n";
+}
+
+int
+main(int argc, char const *argv[])
+{
+    if (argc < 3) {
+        usage(std::string(argv[0]));
+        exit(1);
+    }
+
+    const auto config = toml::parse(argv[1]);
+    auto generator = workload::make_workload_generator(config);
+
+    workload::TraceWriter writer(argv[2]);
+    workload::trace_record record;
+    while (generator.next(record)) {
+        writer.write(record);
+    }
+    writer.close();
+
+    return 0;
+}
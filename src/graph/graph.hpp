@@ -32,6 +32,20 @@ public:
         total_edges_weight_ += weight;
     }
 
+    /*
+        A single access to the keys first to first+length-1, such as a SCAN.
+        It stands for the path linking each key to the next, so it costs
+        the same to track however long it is and cutting it costs as many
+        times its weight as the pieces it is cut into, minus one.
+    */
+    void add_range(T first, int length, int weight = 1) {
+        if (length < 2) {
+            return;
+        }
+        range_weight_[first][length] += weight;
+        total_edges_weight_ += weight * (length - 1);
+    }
+
     void increase_vertice_weight(T vertice, int value = 1) {
         vertex_weight_[vertice] += value;
         total_vertex_weight_ += value;
@@ -60,6 +74,37 @@ public:
         return sorted_vertex_;
     }
 
+    /*
+        Ranges expanded into paths: element i is the weight of the edge
+        between sorted_vertex[i] and sorted_vertex[i+1], summed over the
+        ranges holding both. Keys of a range must be vertex of the graph.
+    */
+    std::vector<int> path_weights(const std::vector<T>& sorted_vertex) const {
+        auto weights = std::vector<int>(sorted_vertex.size(), 0);
+        for (const auto& kv : range_weight_) {
+            auto first = std::lower_bound(
+                sorted_vertex.begin(), sorted_vertex.end(), kv.first
+            ) - sorted_vertex.begin();
+            if (first == sorted_vertex.size()) {
+                continue;
+            }
+            for (const auto& range : kv.second) {
+                auto last = std::min<std::size_t>(
+                    first + range.first - 1, sorted_vertex.size() - 1
+                );
+                weights[first] += range.second;
+                weights[last] -= range.second;
+            }
+        }
+
+        auto weight = 0;
+        for (auto i = 0; i < weights.size(); i++) {
+            weight += weights[i];
+            weights[i] = weight;
+        }
+        return weights;
+    }
+
     std::size_t n_vertex() const {return vertex_weight_.size();}
     std::size_t n_edges() const {return edges_weight_.size();}
     int total_vertex_weight() const {return total_vertex_weight_;}
@@ -75,6 +120,9 @@ private:
     tbb::concurrent_unordered_map<T, int> vertex_weight_;
     tbb::concurrent_unordered_map<T, tbb::concurrent_unordered_map<T, int>>
         edges_weight_;
+    // weight of ranges by their first key and length
+    tbb::concurrent_unordered_map<T, tbb::concurrent_unordered_map<int, int>>
+        range_weight_;
     int n_edges_{0};
     int total_vertex_weight_{0};
     int total_edges_weight_{0};
@@ -7,9 +7,27 @@ bool FIRST_REPARTITION = true;  // Used by ReFENNEL. Its first repartition must
                                 // FENNEL on its place.
 
 
+path_neighbours vertice_path_neighbours(
+    const std::vector<int>& sorted_vertex,
+    const std::vector<int>& path_weights,
+    int index
+) {
+    path_neighbours path;
+    auto vertice = sorted_vertex[index];
+    if (index > 0 and sorted_vertex[index-1] == vertice - 1) {
+        path.previous_weight = path_weights[index-1];
+    }
+    if (index + 1 < sorted_vertex.size() and
+        sorted_vertex[index+1] == vertice + 1)
+    {
+        path.next_weight = path_weights[index];
+    }
+    return path;
+}
+
 std::vector<int> cut_graph (
     const Graph<int>& graph,
-    std::unordered_map<int, int>& vertice_to_partition,
+    const std::unordered_map<int, int>& vertice_to_partition,
     std::unordered_map<int, int>& weight_per_partition,
     CutMethod method
 ) {
@@ -21,6 +39,8 @@ std::vector<int> cut_graph (
         return multilevel_cut(graph, n_partitions, method);
     } else if (method == FENNEL) {
         return fennel_cut(graph, n_partitions);
+    } else if (method == RANGE) {
+        return range_cut(graph, n_partitions);
     } else {
         return refennel_cut(
             graph, vertice_to_partition, weight_per_partition, method);
@@ -35,27 +55,50 @@ std::vector<int> multilevel_cut(
     auto sorted_vertex = std::move(graph.sorted_vertex());
     int n_constrains = 1;
 
+    // the CSR arrays refer to vertex by their index in sorted_vertex
     auto vertice_weight = std::vector<int>();
-    for (auto& vertice : sorted_vertex) {
-        vertice_weight.push_back(vertex.at(vertice));
+    auto vertice_index = std::unordered_map<int, int>();
+    for (auto i = 0; i < sorted_vertex.size(); i++) {
+        vertice_weight.push_back(vertex.at(sorted_vertex[i]));
+        vertice_index.emplace(sorted_vertex[i], i);
     }
 
     auto x_edges = std::vector<int>();
     auto edges = std::vector<int>();
     auto edges_weight = std::vector<int>();
 
+    // ranges become edges between consecutive vertex, merged with
+    // edges already linking them
+    auto path_weights = graph.path_weights(sorted_vertex);
     x_edges.push_back(0);
-    for (auto& vertice : sorted_vertex) {
-        auto last_edge_index = x_edges.back();
-        auto n_neighbours = graph.vertice_edges(vertice).size();
-        x_edges.push_back(last_edge_index + n_neighbours);
-
+    for (auto i = 0; i < sorted_vertex.size(); i++) {
+        auto vertice = sorted_vertex[i];
+        auto path = vertice_path_neighbours(sorted_vertex, path_weights, i);
         for (auto& vk: graph.vertice_edges(vertice)) {
-            auto neighbour = vk.first;
+            auto neighbour = vertice_index.find(vk.first);
+            if (neighbour == vertice_index.end()) {
+                continue;
+            }
             auto weight = vk.second;
-            edges.push_back(neighbour);
+            if (vk.first == vertice - 1) {
+                weight += path.previous_weight;
+                path.previous_weight = 0;
+            } else if (vk.first == vertice + 1) {
+                weight += path.next_weight;
+                path.next_weight = 0;
+            }
+            edges.push_back(neighbour->second);
             edges_weight.push_back(weight);
         }
+        if (path.previous_weight > 0) {
+            edges.push_back(i - 1);
+            edges_weight.push_back(path.previous_weight);
+        }
+        if (path.next_weight > 0) {
+            edges.push_back(i + 1);
+            edges_weight.push_back(path.next_weight);
+        }
+        x_edges.push_back(edges.size());
     }
 
     int options[METIS_NOPTIONS];
@@ -115,12 +158,21 @@ int fennel_vertice_partition(
     int max_partition_size,
     const Graph<int>& graph,
     const std::unordered_map<int, int>& vertice_to_partition,
-    const std::unordered_map<int, int>& weight_per_partition
+    const std::unordered_map<int, int>& weight_per_partition,
+    const path_neighbours& path
 ) {
     double biggest_score = -DBL_MAX;
     auto id = 0;
     auto designated_partition = -1;
     auto neighbours_in_partition = sum_neighbours(graph.vertice_edges(vertice), vertice_to_partition);
+    auto previous = vertice_to_partition.find(vertice - 1);
+    if (path.previous_weight > 0 and previous != vertice_to_partition.end()) {
+        neighbours_in_partition[previous->second] += path.previous_weight;
+    }
+    auto next = vertice_to_partition.find(vertice + 1);
+    if (path.next_weight > 0 and next != vertice_to_partition.end()) {
+        neighbours_in_partition[next->second] += path.next_weight;
+    }
     for (auto i = 0; i < weight_per_partition.size(); i++) {
         auto partition_weight = weight_per_partition.at(i);
         if (max_partition_size) {
@@ -167,17 +219,20 @@ std::pair<std::unordered_map<int, int>, std::unordered_map<int, int>>
         edges_weight * std::pow(n_partitions, (gamma - 1)) / std::pow(graph.total_vertex_weight(), gamma);
 
     auto sorted_vertex = std::move(graph.sorted_vertex());
+    auto path_weights = graph.path_weights(sorted_vertex);
     auto partition_max_size = 1.2 * graph.total_vertex_weight() / n_partitions;
-    for (auto& vertice : sorted_vertex) {
+    for (auto i = 0; i < sorted_vertex.size(); i++) {
+        auto vertice = sorted_vertex[i];
+        auto path = vertice_path_neighbours(sorted_vertex, path_weights, i);
         auto partition = fennel_vertice_partition(
             vertice, alpha, gamma, partition_max_size,
-            graph, vertice_to_partition, weight_per_partition
+            graph, vertice_to_partition, weight_per_partition, path
         );
         if (partition == -1) {
             partition_max_size = 0;  // remove partition limit
             partition = fennel_vertice_partition(
                 vertice, alpha, gamma, partition_max_size,
-                graph, vertice_to_partition, weight_per_partition
+                graph, vertice_to_partition, weight_per_partition, path
             );
         }
         weight_per_partition[partition] += graph.vertice_weight(vertice);
@@ -199,9 +254,40 @@ std::vector<int> fennel_cut(const Graph<int>& graph, int n_partitions) {
     return final_partitioning;
 }
 
+/*
+    Splits the sorted vertex into contiguous ranges of about the same
+    weight, a vertice going to the range its preceding weight falls in.
+    Without any weight, ranges get the same number of vertex instead.
+*/
+std::vector<int> range_cut(const Graph<int>& graph, int n_partitions) {
+    auto sorted_vertex = std::move(graph.sorted_vertex());
+    int64_t total_weight = 0;
+    for (auto& vertice : sorted_vertex) {
+        total_weight += graph.vertice_weight(vertice);
+    }
+
+    auto final_partitioning = std::vector<int>();
+    final_partitioning.reserve(sorted_vertex.size());
+    int64_t preceding_weight = 0;
+    for (auto i = 0; i < sorted_vertex.size(); i++) {
+        int64_t partition;
+        if (total_weight > 0) {
+            partition = preceding_weight * n_partitions / total_weight;
+            preceding_weight += graph.vertice_weight(sorted_vertex[i]);
+        } else {
+            partition = int64_t(i) * n_partitions / sorted_vertex.size();
+        }
+        final_partitioning.push_back(
+            std::min<int64_t>(partition, n_partitions - 1)
+        );
+    }
+
+    return final_partitioning;
+}
+
 std::vector<int> refennel_result(
     const Graph<int>& graph,
-    std::unordered_map<int, int>& vertice_to_partition,
+    const std::unordered_map<int, int>& vertice_to_partition,
     std::unordered_map<int, int>& weight_per_partition
 ) {
     const auto n_partitions = weight_per_partition.size();
@@ -213,17 +299,20 @@ std::vector<int> refennel_result(
 
     auto final_partitioning = std::vector<int>();
     auto sorted_vertex = std::move(graph.sorted_vertex());
+    auto path_weights = graph.path_weights(sorted_vertex);
     auto max_partition_size = 1.2 * graph.total_vertex_weight() / n_partitions;
-    for (auto& vertice : sorted_vertex) {
+    for (auto i = 0; i < sorted_vertex.size(); i++) {
+        auto vertice = sorted_vertex[i];
+        auto path = vertice_path_neighbours(sorted_vertex, path_weights, i);
         auto new_partition = fennel_vertice_partition(
             vertice, alpha, gamma, max_partition_size,
-            graph, vertice_to_partition, weight_per_partition
+            graph, vertice_to_partition, weight_per_partition, path
         );
         if (new_partition == -1) {
             max_partition_size = 0;  // remove partition limit
             new_partition = fennel_vertice_partition(
                 vertice, alpha, gamma, max_partition_size,
-                graph, vertice_to_partition, weight_per_partition
+                graph, vertice_to_partition, weight_per_partition, path
             );
         }
 
@@ -240,7 +329,7 @@ std::vector<int> refennel_result(
 
 std::vector<int> refennel_cut(
     const Graph<int>& graph,
-    std::unordered_map<int, int>& vertice_to_partition,
+    const std::unordered_map<int, int>& vertice_to_partition,
     std::unordered_map<int, int>& weight_per_partition,
     CutMethod method
 ) {
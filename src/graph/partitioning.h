@@ -3,6 +3,7 @@
 
 
 #include <algorithm>
+#include <cstdint>
 #include <float.h>
 #include <fstream>
 #include <kaHIP_interface.h>
@@ -21,19 +22,36 @@
 
 namespace model {
 
-enum CutMethod {METIS, KAHIP, FENNEL, REFENNEL, REFENNEL2, ROUND_ROBIN};
+enum CutMethod {METIS, KAHIP, FENNEL, REFENNEL, REFENNEL2, ROUND_ROBIN, RANGE};
 const std::unordered_map<std::string, CutMethod> string_to_cut_method({
     {"METIS", METIS},
     {"KAHIP", KAHIP},
     {"FENNEL", FENNEL},
     {"REFENNEL", REFENNEL},
     {"REFENNEL2", REFENNEL2},
-    {"ROUND_ROBIN", ROUND_ROBIN}
+    {"ROUND_ROBIN", ROUND_ROBIN},
+    {"RANGE", RANGE}
 });
 
+// set back to true before cutting a new workload with ReFENNEL in the
+// same process, so its first repartition calls FENNEL again
+extern bool FIRST_REPARTITION;
+
+// neighbours of a vertice through the graph's ranges, the keys around it
+struct path_neighbours {
+    int previous_weight = 0;
+    int next_weight = 0;
+};
+
+path_neighbours vertice_path_neighbours(
+    const std::vector<int>& sorted_vertex,
+    const std::vector<int>& path_weights,
+    int index
+);
+
 std::vector<int> cut_graph (
     const Graph<int>& graph,
-    std::unordered_map<int, int>& vertice_to_partition,
+    const std::unordered_map<int, int>& vertice_to_partition,
     std::unordered_map<int, int>& weight_per_partition,
     CutMethod method
 );
@@ -41,9 +59,10 @@ std::vector<int> cut_graph (
 std::vector<int> multilevel_cut
     (const Graph<int>& graph, int n_partitions, CutMethod cut_method);
 std::vector<int> fennel_cut(const Graph<int>& graph, int n_partitions);
+std::vector<int> range_cut(const Graph<int>& graph, int n_partitions);
 std::vector<int> refennel_cut(
     const Graph<int>& graph,
-    std::unordered_map<int, int>& vertice_to_partition,
+    const std::unordered_map<int, int>& vertice_to_partition,
     std::unordered_map<int, int>& size_per_partition,
     CutMethod method
 );
@@ -59,7 +78,8 @@ int fennel_vertice_partition(
     int max_partition_size,
     const Graph<int>& graph,
     const std::unordered_map<int, int>& vertice_to_partition,
-    const std::unordered_map<int, int>& weight_per_partition
+    const std::unordered_map<int, int>& weight_per_partition,
+    const path_neighbours& path = path_neighbours()
 );
 
 }
@@ -0,0 +1,97 @@
+#include "histogram.h"
+
+
+namespace metrics {
+
+int bucket_index(uint64_t value) {
+    if (value < 2*SUB_BUCKETS) {
+        return value;
+    }
+
+    auto highest_bit = 63 - __builtin_clzll(value);
+    auto shift = highest_bit - SUB_BUCKET_BITS;
+    auto sub_bucket = (value >> shift) - SUB_BUCKETS;
+    return 2*SUB_BUCKETS + (shift - 1)*SUB_BUCKETS + sub_bucket;
+}
+
+uint64_t bucket_highest_value(int index) {
+    if (index < 2*SUB_BUCKETS) {
+        return index;
+    }
+
+    auto shift = (index - 2*SUB_BUCKETS) / SUB_BUCKETS + 1;
+    uint64_t sub_bucket = (index - 2*SUB_BUCKETS) % SUB_BUCKETS + SUB_BUCKETS;
+    return ((sub_bucket + 1) << shift) - 1;
+}
+
+HistogramSnapshot::HistogramSnapshot()
+    : counts_(N_BUCKETS, 0)
+{}
+
+void HistogramSnapshot::merge(const HistogramSnapshot& other) {
+    for (auto i = 0; i < N_BUCKETS; i++) {
+        counts_[i] += other.counts_[i];
+    }
+    count_ += other.count_;
+}
+
+HistogramSnapshot HistogramSnapshot::since(
+    const HistogramSnapshot& previous) const
+{
+    HistogramSnapshot interval;
+    for (auto i = 0; i < N_BUCKETS; i++) {
+        interval.counts_[i] = counts_[i] - previous.counts_[i];
+    }
+    interval.count_ = count_ - previous.count_;
+    return interval;
+}
+
+uint64_t HistogramSnapshot::percentile(double percentile) const {
+    if (count_ == 0) {
+        return 0;
+    }
+
+    uint64_t rank = percentile / 100.0 * count_;
+    rank = std::max<uint64_t>(rank, 1);
+    uint64_t seen = 0;
+    for (auto i = 0; i < N_BUCKETS; i++) {
+        seen += counts_[i];
+        if (seen >= rank) {
+            return bucket_highest_value(i);
+        }
+    }
+    return max();
+}
+
+uint64_t HistogramSnapshot::max() const {
+    for (auto i = N_BUCKETS - 1; i >= 0; i--) {
+        if (counts_[i] > 0) {
+            return bucket_highest_value(i);
+        }
+    }
+    return 0;
+}
+
+Histogram::Histogram()
+    : counts_(new std::atomic<uint64_t>[N_BUCKETS])
+{
+    for (auto i = 0; i < N_BUCKETS; i++) {
+        counts_[i] = 0;
+    }
+}
+
+void Histogram::record(uint64_t value) {
+    counts_[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+}
+
+HistogramSnapshot Histogram::snapshot() const {
+    HistogramSnapshot snapshot;
+    for (auto i = 0; i < N_BUCKETS; i++) {
+        auto count = counts_[i].load(std::memory_order_relaxed);
+        snapshot.counts_[i] = count;
+        snapshot.count_ += count;
+    }
+    return snapshot;
+}
+
+}
@@ -0,0 +1,62 @@
+#ifndef _KVPAXOS_HISTOGRAM_H_
+#define _KVPAXOS_HISTOGRAM_H_
+
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+
+namespace metrics {
+
+/*
+    Buckets follow HdrHistogram's log-linear layout. Values below
+    2*SUB_BUCKETS get a bucket each, larger values are grouped by their
+    highest set bit and every group is split into SUB_BUCKETS linear
+    buckets, which keeps the relative error under 1/SUB_BUCKETS.
+*/
+const int SUB_BUCKET_BITS = 6;
+const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+const int N_BUCKETS = 2*SUB_BUCKETS + (64 - SUB_BUCKET_BITS - 1)*SUB_BUCKETS;
+
+int bucket_index(uint64_t value);
+uint64_t bucket_highest_value(int index);
+
+class HistogramSnapshot {
+public:
+    HistogramSnapshot();
+
+    void merge(const HistogramSnapshot& other);
+    HistogramSnapshot since(const HistogramSnapshot& previous) const;
+
+    uint64_t count() const {return count_;}
+    uint64_t percentile(double percentile) const;
+    uint64_t max() const;
+
+private:
+    friend class Histogram;
+
+    std::vector<uint64_t> counts_;
+    uint64_t count_{0};
+};
+
+/*
+    Histogram meant to be written by a single thread. record() is wait-free
+    and snapshots may be taken by any other thread at any time.
+*/
+class Histogram {
+public:
+    Histogram();
+
+    void record(uint64_t value);
+    HistogramSnapshot snapshot() const;
+
+private:
+    std::unique_ptr<std::atomic<uint64_t>[]> counts_;
+};
+
+}
+
+#endif
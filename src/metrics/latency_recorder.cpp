@@ -0,0 +1,122 @@
+#include "latency_recorder.h"
+
+
+namespace metrics {
+
+const char* type_names[N_REQUEST_TYPES] = {
+    "READ", "WRITE", "SCAN", "SYNC", "ERROR"
+};
+
+std::size_t next_power_of_two(std::size_t value) {
+    std::size_t power = 1;
+    while (power < value) {
+        power <<= 1;
+    }
+    return power;
+}
+
+LatencyRecorder::LatencyRecorder(
+    int n_listener_threads, std::size_t ring_size)
+    : ring_mask_{next_power_of_two(ring_size) - 1},
+      histograms_(n_listener_threads)
+{
+    sent_ring_.reset(new sent_slot[ring_mask_ + 1]);
+}
+
+// settled slots hold -1, whoever swaps the request id out settles it
+bool LatencyRecorder::settle(sent_slot& slot, int request_id) {
+    return slot.request_id.compare_exchange_strong(
+        request_id, -1, std::memory_order_acq_rel
+    );
+}
+
+bool LatencyRecorder::sent(int request_id, int64_t timestamp_ns) {
+    // an unsettled previous request means more requests were in flight
+    // than the ring holds, it can't be tracked anymore
+    auto& slot = sent_ring_[request_id & ring_mask_];
+    auto previous = slot.request_id.load(std::memory_order_acquire);
+    auto expired = previous >= 0 and settle(slot, previous);
+    if (expired) {
+        n_expired_.fetch_add(1, std::memory_order_relaxed);
+    }
+    slot.timestamp_ns.store(timestamp_ns, std::memory_order_relaxed);
+    slot.request_id.store(request_id, std::memory_order_release);
+    return expired;
+}
+
+int64_t LatencyRecorder::answered(
+    int listener_id, int request_id, int type, int64_t timestamp_ns)
+{
+    // answers to requests that expired or were answered by another replica
+    // first are lost samples
+    auto& slot = sent_ring_[request_id & ring_mask_];
+    if (type < 0 or type >= N_REQUEST_TYPES or
+        slot.request_id.load(std::memory_order_acquire) != request_id)
+    {
+        n_lost_samples_.fetch_add(1, std::memory_order_relaxed);
+        return -1;
+    }
+    auto sent_ns = slot.timestamp_ns.load(std::memory_order_relaxed);
+    if (not settle(slot, request_id)) {
+        n_lost_samples_.fetch_add(1, std::memory_order_relaxed);
+        return -1;
+    }
+
+    auto latency = std::max<int64_t>(timestamp_ns - sent_ns, 0);
+    histograms_[listener_id][type].record(latency);
+    return latency;
+}
+
+bool LatencyRecorder::expire(int request_id) {
+    auto& slot = sent_ring_[request_id & ring_mask_];
+    if (not settle(slot, request_id)) {
+        return false;
+    }
+    n_expired_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+LatencyRecorder::snapshots LatencyRecorder::merged_snapshots() const {
+    snapshots merged;
+    for (const auto& listener_histograms : histograms_) {
+        for (auto type = 0; type < N_REQUEST_TYPES; type++) {
+            merged[type].merge(listener_histograms[type].snapshot());
+        }
+    }
+    return merged;
+}
+
+void LatencyRecorder::report(std::ostream& out, long epoch) {
+    auto current = merged_snapshots();
+    snapshots interval;
+    for (auto type = 0; type < N_REQUEST_TYPES; type++) {
+        interval[type] = current[type].since(last_report_[type]);
+    }
+    last_report_ = current;
+    print(out, std::to_string(epoch), interval);
+}
+
+void LatencyRecorder::report_total(std::ostream& out) {
+    print(out, "TOTAL", merged_snapshots());
+}
+
+void LatencyRecorder::print(std::ostream& out, const std::string& label,
+    const snapshots& histograms) const
+{
+    for (auto type = 0; type < N_REQUEST_TYPES; type++) {
+        const auto& histogram = histograms[type];
+        if (histogram.count() == 0) {
+            continue;
+        }
+
+        out << label << "," << type_names[type] << ",";
+        out << histogram.count() << ",";
+        out << histogram.percentile(50) << ",";
+        out << histogram.percentile(99) << ",";
+        out << histogram.percentile(99.9) << ",";
+        out << histogram.max() << "\n";
+    }
+    out.flush();
+}
+
+}
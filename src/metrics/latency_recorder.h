@@ -0,0 +1,70 @@
+#ifndef _KVPAXOS_LATENCY_RECORDER_H_
+#define _KVPAXOS_LATENCY_RECORDER_H_
+
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "histogram.h"
+#include "types/types.h"
+
+
+namespace metrics {
+
+const int N_REQUEST_TYPES = ERROR + 1;
+
+/*
+    Keeps the send time of in-flight requests in a preallocated ring indexed
+    by request id and records every answer's latency in histograms owned by
+    the listener thread that received it, one per request type. report()
+    merges all histograms and prints what was recorded since its last call.
+    A request is settled once, either by its first answer or by expiring,
+    so callers know which of them frees its place among in-flight requests.
+*/
+class LatencyRecorder {
+public:
+    LatencyRecorder(int n_listener_threads, std::size_t ring_size);
+
+    // whether an older unsettled request had to be expired for the slot
+    bool sent(int request_id, int64_t timestamp_ns);
+    // the latency recorded, or -1 when the request was already settled
+    int64_t answered(
+        int listener_id, int request_id, int type, int64_t timestamp_ns
+    );
+    // gives up on an unanswered request, false if it was already settled
+    bool expire(int request_id);
+
+    void report(std::ostream& out, long epoch);
+    void report_total(std::ostream& out);
+    uint64_t n_lost_samples() const {return n_lost_samples_;}
+    uint64_t n_expired() const {return n_expired_;}
+
+private:
+    struct sent_slot {
+        std::atomic<int> request_id{-1};
+        std::atomic<int64_t> timestamp_ns{0};
+    };
+
+    typedef std::array<HistogramSnapshot, N_REQUEST_TYPES> snapshots;
+
+    bool settle(sent_slot& slot, int request_id);
+    snapshots merged_snapshots() const;
+    void print(std::ostream& out, const std::string& label,
+        const snapshots& histograms) const;
+
+    std::unique_ptr<sent_slot[]> sent_ring_;
+    std::size_t ring_mask_;
+    std::vector<std::array<Histogram, N_REQUEST_TYPES>> histograms_;
+    snapshots last_report_;
+    std::atomic<uint64_t> n_lost_samples_{0};
+    std::atomic<uint64_t> n_expired_{0};
+};
+
+}
+
+#endif
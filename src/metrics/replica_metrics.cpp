@@ -0,0 +1,165 @@
+#include "replica_metrics.h"
+
+#include <chrono>
+#include <fstream>
+#include <poll.h>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+namespace metrics {
+
+const int ACCEPT_TIMEOUT_MS = 100;
+
+void write_json(std::ostream& out, const replica_sample& sample) {
+    auto cross_partition_ratio = sample.n_scheduled_requests == 0 ? 0.0 :
+        double(sample.n_cross_partition_requests) / sample.n_scheduled_requests;
+
+    out << "{\"epoch\":" << sample.epoch;
+    out << ",\"partitions\":[";
+    for (auto i = 0; i < sample.partitions.size(); i++) {
+        const auto& partition = sample.partitions[i];
+        if (i > 0) {
+            out << ",";
+        }
+        out << "{\"id\":" << partition.id;
+        out << ",\"queue_depth\":" << partition.queue_depth;
+        out << ",\"executed\":" << partition.n_executed_requests;
+        out << ",\"sync_wait_ns\":" << partition.sync_wait_ns;
+        out << ",\"cache_hits\":" << partition.cache_hits;
+        out << ",\"cache_misses\":" << partition.cache_misses << "}";
+    }
+    out << "]";
+    out << ",\"scheduled\":" << sample.n_scheduled_requests;
+    out << ",\"cross_partition\":" << sample.n_cross_partition_requests;
+    out << ",\"cross_partition_ratio\":" << cross_partition_ratio;
+    out << ",\"tracker_backlog\":" << sample.tracker_backlog;
+    out << ",\"repartitions\":" << sample.n_repartitions;
+    out << ",\"last_repartition_ns\":" << sample.last_repartition_duration_ns;
+    out << ",\"total_repartition_ns\":" << sample.total_repartition_duration_ns;
+    out << ",\"last_keys_moved\":" << sample.last_keys_moved;
+    out << ",\"total_keys_moved\":" << sample.total_keys_moved;
+    out << ",\"storage_bytes\":" << sample.storage_bytes;
+    out << ",\"delivery_queue_depth\":" << sample.delivery_queue_depth;
+    out << ",\"delivery_stalls\":" << sample.n_delivery_stalls;
+    out << "}";
+}
+
+MetricsExporter::MetricsExporter(sampler sample, const std::string& path,
+    int interval_ms, const std::string& socket_path)
+    : sample_{sample},
+      path_{path},
+      socket_path_{socket_path},
+      interval_ms_{interval_ms}
+{}
+
+MetricsExporter::~MetricsExporter() {
+    stop();
+}
+
+void MetricsExporter::start() {
+    running_ = true;
+    dump_thread_ = std::thread(&MetricsExporter::dump_loop, this);
+
+    if (socket_path_.empty()) {
+        return;
+    }
+    socket_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socket_fd_ < 0) {
+        printf("Failed to create metrics socket\n");
+        return;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path_.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(socket_path_.c_str());
+    if (bind(socket_fd_, (struct sockaddr*) &addr, sizeof(addr)) < 0 or
+        listen(socket_fd_, 8) < 0)
+    {
+        printf("Failed to bind metrics socket %s\n", socket_path_.c_str());
+        close(socket_fd_);
+        socket_fd_ = -1;
+        return;
+    }
+    serve_thread_ = std::thread(&MetricsExporter::serve_loop, this);
+}
+
+void MetricsExporter::stop() {
+    running_ = false;
+    if (dump_thread_.joinable()) {
+        dump_thread_.join();
+    }
+    if (serve_thread_.joinable()) {
+        serve_thread_.join();
+    }
+    if (socket_fd_ >= 0) {
+        close(socket_fd_);
+        unlink(socket_path_.c_str());
+        socket_fd_ = -1;
+    }
+}
+
+void MetricsExporter::dump_loop() {
+    std::ofstream file(path_, std::ios::app);
+    if (not file) {
+        printf("Failed to open metrics file %s\n", path_.c_str());
+    }
+
+    auto interval = std::chrono::milliseconds(interval_ms_);
+    auto next_dump = std::chrono::steady_clock::now() + interval;
+    while (running_) {
+        // sleeps in short steps so that stopping doesn't wait an interval
+        auto now = std::chrono::steady_clock::now();
+        if (now < next_dump) {
+            std::this_thread::sleep_for(std::min<std::chrono::nanoseconds>(
+                next_dump - now, std::chrono::milliseconds(ACCEPT_TIMEOUT_MS)
+            ));
+            continue;
+        }
+        next_dump += interval;
+
+        std::ostringstream line;
+        write_json(line, sample_());
+        line << "\n";
+        if (file) {
+            file << line.str() << std::flush;
+        }
+
+        std::lock_guard<std::mutex> lock(last_sample_mutex_);
+        last_sample_ = line.str();
+    }
+}
+
+void MetricsExporter::serve_loop() {
+    struct pollfd listener;
+    listener.fd = socket_fd_;
+    listener.events = POLLIN;
+    while (running_) {
+        if (poll(&listener, 1, ACCEPT_TIMEOUT_MS) <= 0) {
+            continue;
+        }
+        auto connection = accept(socket_fd_, NULL, NULL);
+        if (connection < 0) {
+            continue;
+        }
+
+        std::string sample;
+        {
+            std::lock_guard<std::mutex> lock(last_sample_mutex_);
+            sample = last_sample_;
+        }
+        auto n_written = write(connection, sample.data(), sample.size());
+        if (n_written < 0) {
+            printf("Failed to write metrics to socket\n");
+        }
+        close(connection);
+    }
+}
+
+}
@@ -0,0 +1,83 @@
+#ifndef _KVPAXOS_REPLICA_METRICS_H_
+#define _KVPAXOS_REPLICA_METRICS_H_
+
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace metrics {
+
+struct partition_sample {
+    int id;
+    int queue_depth;
+    int64_t n_executed_requests;
+    int64_t sync_wait_ns;
+    uint64_t cache_hits;
+    uint64_t cache_misses;
+};
+
+/*
+    A point in time view of a replica. Counters are cumulative since the
+    replica started, so consumers get rates by diffing consecutive samples.
+*/
+struct replica_sample {
+    long epoch;
+    std::vector<partition_sample> partitions;
+    int64_t n_scheduled_requests;
+    int64_t n_cross_partition_requests;
+    int tracker_backlog;
+    int64_t n_repartitions;
+    int64_t last_repartition_duration_ns;
+    int64_t total_repartition_duration_ns;
+    int64_t last_keys_moved;
+    int64_t total_keys_moved;
+    std::size_t storage_bytes;
+    std::size_t delivery_queue_depth;
+    uint64_t n_delivery_stalls;
+};
+
+// writes a sample as a single line JSON object
+void write_json(std::ostream& out, const replica_sample& sample);
+
+/*
+    Takes a sample every interval and appends it to a file as a JSON line.
+    If socket_path isn't empty, it also listens on a unix socket there and
+    writes the latest sample to every connection, so a running replica can
+    be inspected with e.g. `nc -U`.
+*/
+class MetricsExporter {
+public:
+    typedef std::function<replica_sample()> sampler;
+
+    MetricsExporter(sampler sample, const std::string& path,
+        int interval_ms, const std::string& socket_path = "");
+    ~MetricsExporter();
+
+    void start();
+    void stop();
+
+private:
+    void dump_loop();
+    void serve_loop();
+
+    sampler sample_;
+    std::string path_, socket_path_;
+    int interval_ms_;
+    int socket_fd_{-1};
+
+    std::atomic<bool> running_{false};
+    std::thread dump_thread_, serve_thread_;
+    std::mutex last_sample_mutex_;
+    std::string last_sample_;
+};
+
+}
+
+#endif
@@ -0,0 +1,198 @@
+#include "stage_tracer.h"
+
+#include <fstream>
+#include <stdio.h>
+#include <unordered_map>
+
+#include "histogram.h"
+
+
+namespace metrics {
+
+void StageTracer::enable(unsigned sample_period, std::size_t buffer_capacity)
+{
+    // sampling uses a mask, so the period is rounded up to a power of two
+    uint32_t period = 1;
+    while (period < sample_period) {
+        period <<= 1;
+    }
+    sample_mask_ = period - 1;
+    buffer_capacity_ = buffer_capacity;
+    start_tsc_ = read_tsc();
+    start_time_ = std::chrono::steady_clock::now();
+    enabled_ = true;
+}
+
+StageTracer::thread_buffer* StageTracer::local_buffer() {
+    thread_local thread_buffer* buffer = nullptr;
+    if (buffer == nullptr) {
+        std::lock_guard<std::mutex> lock(buffers_mutex_);
+        buffers_.emplace_back(new thread_buffer());
+        buffer = buffers_.back().get();
+        buffer->events.reset(new trace_event[buffer_capacity_]);
+        buffer->thread_id = buffers_.size() - 1;
+    }
+    return buffer;
+}
+
+void StageTracer::record_event(trace_stage stage, int request_id,
+    unsigned short port, uint64_t tsc)
+{
+    auto* buffer = local_buffer();
+    auto size = buffer->size.load(std::memory_order_relaxed);
+    if (size == buffer_capacity_) {
+        n_dropped_events_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    auto& event = buffer->events[size];
+    event.tsc = tsc;
+    event.request_id = request_id;
+    event.port = port;
+    event.stage = stage;
+    event.thread_id = buffer->thread_id;
+    buffer->size.store(size + 1, std::memory_order_release);
+}
+
+std::size_t StageTracer::dump(const std::string& path) {
+    auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start_time_
+    ).count();
+    auto elapsed_ticks = read_tsc() - start_tsc_;
+
+    std::lock_guard<std::mutex> lock(buffers_mutex_);
+    stage_trace_header header;
+    header.magic = STAGE_TRACE_MAGIC;
+    header.version = STAGE_TRACE_VERSION;
+    header.event_size = sizeof(trace_event);
+    header.ticks_per_ns = elapsed_ns > 0 ?
+        double(elapsed_ticks) / elapsed_ns : 1.0;
+    header.n_events = 0;
+    for (const auto& buffer : buffers_) {
+        header.n_events += buffer->size.load(std::memory_order_acquire);
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (not file) {
+        printf("Failed to open stage trace file %s\n", path.c_str());
+        return 0;
+    }
+    file.write((const char*) &header, sizeof(header));
+    std::size_t n_written = 0;
+    for (const auto& buffer : buffers_) {
+        auto size = std::min<std::size_t>(
+            buffer->size.load(std::memory_order_acquire),
+            header.n_events - n_written
+        );
+        file.write(
+            (const char*) buffer->events.get(), size * sizeof(trace_event)
+        );
+        n_written += size;
+    }
+    return n_written;
+}
+
+const int N_ANALYZED_STAGES = 6;
+const char* analyzed_stage_names[N_ANALYZED_STAGES] = {
+    "SCHEDULE", "QUEUE", "SYNC", "EXECUTE", "REPLY", "TOTAL"
+};
+
+void analyze_stage_trace(const std::string& path, std::ostream& out) {
+    std::ifstream file(path, std::ios::binary);
+    stage_trace_header header;
+    file.read((char*) &header, sizeof(header));
+    if (not file or header.magic != STAGE_TRACE_MAGIC or
+        header.version != STAGE_TRACE_VERSION or
+        header.event_size != sizeof(trace_event))
+    {
+        printf("%s is not a stage trace\n", path.c_str());
+        return;
+    }
+
+    std::vector<trace_event> events(header.n_events);
+    file.read((char*) events.data(), events.size() * sizeof(trace_event));
+    events.resize(file.gcount() / sizeof(trace_event));
+
+    // a request is identified by its id and the port its answer goes to
+    std::unordered_map<uint64_t, std::vector<const trace_event*>> requests;
+    for (const auto& event : events) {
+        auto request = uint64_t(event.port) << 32 | uint32_t(event.request_id);
+        requests[request].push_back(&event);
+    }
+
+    std::vector<Histogram> histograms(N_ANALYZED_STAGES);
+    auto to_ns = [&header](uint64_t ticks) -> uint64_t {
+        return ticks / header.ticks_per_ns;
+    };
+    for (const auto& kv : requests) {
+        const trace_event* stages[N_TRACE_STAGES] = {nullptr};
+        for (const auto* event : kv.second) {
+            if (event->stage < N_TRACE_STAGES and
+                event->stage != SYNC_ENTERED and event->stage != SYNC_EXITED)
+            {
+                stages[event->stage] = event;
+            }
+        }
+        if (stages[DELIVERED] == nullptr or stages[DISPATCHED] == nullptr or
+            stages[DEQUEUED] == nullptr or stages[EXECUTED] == nullptr or
+            stages[ANSWERED] == nullptr)
+        {
+            continue;
+        }
+
+        // only the sync the executing partition waited at before running
+        // the request delayed it
+        auto executor = stages[DEQUEUED]->thread_id;
+        uint64_t sync_ticks = 0, sync_start = 0;
+        auto synced = false;
+        for (const auto* event : kv.second) {
+            if (event->thread_id != executor or
+                event->tsc > stages[DEQUEUED]->tsc)
+            {
+                continue;
+            }
+            if (event->stage == SYNC_ENTERED) {
+                sync_start = event->tsc;
+            } else if (event->stage == SYNC_EXITED and sync_start != 0) {
+                sync_ticks += event->tsc - sync_start;
+                synced = true;
+            }
+        }
+
+        auto queue_ticks = stages[DEQUEUED]->tsc - stages[DISPATCHED]->tsc;
+        histograms[0].record(
+            to_ns(stages[DISPATCHED]->tsc - stages[DELIVERED]->tsc)
+        );
+        histograms[1].record(
+            to_ns(queue_ticks - std::min(queue_ticks, sync_ticks))
+        );
+        if (synced) {
+            histograms[2].record(to_ns(sync_ticks));
+        }
+        histograms[3].record(
+            to_ns(stages[EXECUTED]->tsc - stages[DEQUEUED]->tsc)
+        );
+        histograms[4].record(
+            to_ns(stages[ANSWERED]->tsc - stages[EXECUTED]->tsc)
+        );
+        histograms[5].record(
+            to_ns(stages[ANSWERED]->tsc - stages[DELIVERED]->tsc)
+        );
+    }
+
+    for (auto i = 0; i < N_ANALYZED_STAGES; i++) {
+        auto histogram = histograms[i].snapshot();
+        if (histogram.count() == 0) {
+            continue;
+        }
+        out << analyzed_stage_names[i] << ",";
+        out << histogram.count() << ",";
+        out << histogram.percentile(50) << ",";
+        out << histogram.percentile(99) << ",";
+        out << histogram.percentile(99.9) << ",";
+        out << histogram.max() << "\n";
+    }
+    out.flush();
+}
+
+}
@@ -0,0 +1,131 @@
+#ifndef _KVPAXOS_STAGE_TRACER_H_
+#define _KVPAXOS_STAGE_TRACER_H_
+
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+
+namespace metrics {
+
+// stages a request goes through in the replica, in order
+enum trace_stage : uint8_t {
+    DELIVERED,
+    DISPATCHED,
+    SYNC_ENTERED,
+    SYNC_EXITED,
+    DEQUEUED,
+    EXECUTED,
+    ANSWERED,
+    N_TRACE_STAGES
+};
+
+const uint32_t STAGE_TRACE_MAGIC = 0x5453564b;  // "KVST"
+const uint16_t STAGE_TRACE_VERSION = 1;
+
+struct trace_event {
+    uint64_t tsc;
+    int32_t request_id;
+    uint16_t port;
+    uint8_t stage;
+    uint8_t thread_id;
+};
+
+struct __attribute__((packed)) stage_trace_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t event_size;
+    double ticks_per_ns;
+    uint64_t n_events;
+};
+
+inline uint64_t read_tsc() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+/*
+    Timestamps one in every sample_period requests, picked by a hash of
+    their id and reply port, at each stage they go through. Events are
+    appended to a fixed size buffer owned by the recording thread, so
+    recording takes no locks, and are written to a file by dump(). While
+    disabled, record() costs a single relaxed load.
+*/
+class StageTracer {
+public:
+    static void enable(unsigned sample_period, std::size_t buffer_capacity);
+    static bool enabled() {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    static bool sampled(int request_id, unsigned short port) {
+        auto hash = (uint32_t(request_id) ^ (uint32_t(port) << 16)) *
+            2654435761u;
+        return (hash >> 8 & sample_mask_) == 0;
+    }
+
+    static void record(trace_stage stage, int request_id,
+        unsigned short port)
+    {
+        if (enabled() and sampled(request_id, port)) {
+            record_event(stage, request_id, port, read_tsc());
+        }
+    }
+
+    // records a stage reached at tsc, read earlier with read_tsc()
+    static void record(trace_stage stage, int request_id,
+        unsigned short port, uint64_t tsc)
+    {
+        if (enabled() and sampled(request_id, port)) {
+            record_event(stage, request_id, port, tsc);
+        }
+    }
+
+    static std::size_t dump(const std::string& path);
+    static std::size_t n_dropped_events() {return n_dropped_events_;}
+
+private:
+    struct thread_buffer {
+        std::unique_ptr<trace_event[]> events;
+        std::atomic<std::size_t> size{0};
+        uint8_t thread_id;
+    };
+
+    static thread_buffer* local_buffer();
+    static void record_event(trace_stage stage, int request_id,
+        unsigned short port, uint64_t tsc);
+
+    static inline std::atomic<bool> enabled_{false};
+    static inline uint32_t sample_mask_{0};
+    static inline std::size_t buffer_capacity_{0};
+    static inline uint64_t start_tsc_{0};
+    static inline std::chrono::steady_clock::time_point start_time_;
+    static inline std::atomic<std::size_t> n_dropped_events_{0};
+
+    static inline std::mutex buffers_mutex_;
+    static inline std::vector<std::unique_ptr<thread_buffer>> buffers_;
+};
+
+/*
+    Reads a file written by StageTracer::dump and prints, for every stage,
+    the latency distribution of the sampled requests that were answered in
+    the same CSV format as the client's reports.
+*/
+void analyze_stage_trace(const std::string& path, std::ostream& out);
+
+}
+
+#endif
@@ -0,0 +1,225 @@
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "compresser/compresser.h"
+#include "constants/constants.h"
+#include "graph/graph.hpp"
+#include "graph/partitioning.h"
+#include "scheduler/pattern_tracker.hpp"
+#include "storage/storage.h"
+#include "storage/value_cache.h"
+#include "types/types.h"
+
+
+const int N_KEYS = 100000;
+const int N_OPERATIONS = 1000000;
+const int N_PARTITIONS = 8;
+
+// keeps results alive so the compiler doesn't optimize the work away
+static volatile std::size_t sink;
+
+/*
+    Runs operation n_operations times and prints the benchmark's name,
+    number of operations, total time in milliseconds and nanoseconds per
+    operation as a CSV line. Benchmarks whose name doesn't contain filter
+    are skipped.
+*/
+static void
+run_benchmark(const std::string& name, const std::string& filter,
+    int n_operations, const std::function<void(int)>& operation)
+{
+    if (name.find(filter) == std::string::npos) {
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (auto i = 0; i < n_operations; i++) {
+        operation(i);
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start
+    ).count();
+
+    std::cout << name << "," << n_operations << ",";
+    std::cout << elapsed / 1000000 << ",";
+    std::cout << double(elapsed) / n_operations << "\n";
+}
+
+static std::vector<int>
+random_keys(int n_keys, int n_operations, unsigned seed)
+{
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<int> key(0, n_keys - 1);
+    std::vector<int> keys(n_operations);
+    for (auto& k : keys) {
+        k = key(generator);
+    }
+    return keys;
+}
+
+static void
+benchmark_codecs(const std::string& filter)
+{
+    auto value = std::string(VALUE_SIZE, '*');
+    auto compressed = compress(value);
+    char buffer[VALUE_SIZE];
+
+    run_benchmark("compress", filter, N_OPERATIONS / 10, [&](int i) {
+        sink = compress(value).size();
+    });
+    run_benchmark("decompress", filter, N_OPERATIONS, [&](int i) {
+        sink = decompress(compressed).size();
+    });
+    run_benchmark("decompress_into_buffer", filter, N_OPERATIONS, [&](int i) {
+        sink = decompress(compressed, buffer, sizeof(buffer));
+    });
+}
+
+static void
+benchmark_storage(const std::string& filter)
+{
+    kvstorage::Storage storage;
+    auto value = std::string(VALUE_SIZE, '*');
+    for (auto key = 0; key < N_KEYS; key++) {
+        storage.write(key, value);
+    }
+
+    auto keys = random_keys(N_KEYS, N_OPERATIONS, 0);
+    // keys that all fit in a partition's cache once read
+    auto hot_keys = random_keys(VALUE_CACHE_SIZE, N_OPERATIONS, 1);
+    kvstorage::ValueCache cache, hot_cache;
+    reply_message reply;
+    auto capacity = sizeof(reply.answer) - 1;
+
+    run_benchmark("storage_read", filter, N_OPERATIONS, [&](int i) {
+        sink = storage.read(keys[i]).size();
+    });
+    run_benchmark("storage_read_cache_miss", filter, N_OPERATIONS, [&](int i) {
+        sink = storage.read(keys[i], reply.answer, capacity, cache);
+    });
+    run_benchmark("storage_read_cache_hit", filter, N_OPERATIONS, [&](int i) {
+        sink = storage.read(hot_keys[i], reply.answer, capacity, hot_cache);
+    });
+    run_benchmark("storage_write", filter, N_OPERATIONS / 10, [&](int i) {
+        storage.write(keys[i], value, cache);
+    });
+    run_benchmark("storage_scan", filter, N_OPERATIONS / 10, [&](int i) {
+        sink = storage.scan(
+            keys[i], MAX_SCAN_LENGTH, reply.answer, capacity, cache
+        );
+    });
+}
+
+static std::vector<struct command>
+random_requests(int n_keys, int n_requests, unsigned seed)
+{
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<int> key(0, n_keys - 1);
+    std::uniform_int_distribution<int> scan_length(2, MAX_SCAN_LENGTH);
+    std::bernoulli_distribution is_scan(0.1);
+
+    std::vector<struct command> requests(n_requests);
+    for (auto& request : requests) {
+        request.key = key(generator);
+        if (is_scan(generator)) {
+            request.type = SCAN;
+            request.scan_length = std::min(
+                scan_length(generator), n_keys - request.key
+            );
+        } else {
+            request.type = READ;
+            request.scan_length = 1;
+        }
+    }
+    return requests;
+}
+
+static void
+benchmark_graph_updates(const std::string& filter)
+{
+    auto requests = random_requests(N_KEYS, N_OPERATIONS, 0);
+    kvpaxos::PatternTracker<int> tracker(N_PARTITIONS);
+    tracker.populate_n_sequential_vertices(N_KEYS);
+
+    run_benchmark("graph_update", filter, N_OPERATIONS, [&](int i) {
+        tracker.update_workload_graph(requests[i]);
+    });
+}
+
+static void
+benchmark_cut_methods(const std::string& filter, int max_graph_size)
+{
+    const std::vector<std::pair<std::string, model::CutMethod>> methods{
+        {"METIS", model::METIS},
+        {"KAHIP", model::KAHIP},
+        {"FENNEL", model::FENNEL},
+        {"REFENNEL", model::REFENNEL},
+        {"REFENNEL2", model::REFENNEL2},
+    };
+
+    for (auto n_vertex = 1000; n_vertex <= max_graph_size; n_vertex *= 10) {
+        // a graph shaped like the tracker's, ten accesses per vertex
+        kvpaxos::PatternTracker<int> tracker(N_PARTITIONS);
+        tracker.populate_n_sequential_vertices(n_vertex);
+        for (const auto& request : random_requests(n_vertex, 10*n_vertex, 1)) {
+            tracker.update_workload_graph(request);
+        }
+        const auto& graph = tracker.workload_graph();
+
+        std::unordered_map<int, int> vertice_to_partition;
+        std::unordered_map<int, int> weight_per_partition;
+        for (auto i = 0; i < N_PARTITIONS; i++) {
+            weight_per_partition[i] = 0;
+        }
+        for (auto vertice = 0; vertice < n_vertex; vertice++) {
+            vertice_to_partition[vertice] = vertice % N_PARTITIONS;
+            weight_per_partition[vertice % N_PARTITIONS] +=
+                graph.vertice_weight(vertice);
+        }
+
+        for (const auto& kv : methods) {
+            auto name = "cut_" + kv.first + "_" + std::to_string(n_vertex);
+            // cuts may update the weights, so each one gets its own copy
+            auto weight_per_partition_copy = weight_per_partition;
+            // REFENNEL always refines the round robin mapping above
+            // instead of running FENNEL on the first graph only
+            model::FIRST_REPARTITION = false;
+            run_benchmark(name, filter, 1, [&](int i) {
+                sink = model::cut_graph(
+                    graph, vertice_to_partition,
+                    weight_per_partition_copy, kv.second
+                ).size();
+            });
+        }
+    }
+}
+
+static void
+usage(std::string prog)
+{
+    std::cout << "Usage: " << prog << " [filter] [max_graph_size]\n";
+}
+
+int
+main(int argc, char const *argv[])
+{
+    if (argc > 1 and std::string(argv[1]) == "-h") {
+        usage(std::string(argv[0]));
+        exit(0);
+    }
+    auto filter = argc > 1 ? std::string(argv[1]) : std::string("");
+    auto max_graph_size = argc > 2 ? atoi(argv[2]) : 100000;
+
+    std::cout << "BENCHMARK,OPERATIONS,TOTAL_MS,NS_PER_OPERATION\n";
+    benchmark_codecs(filter);
+    benchmark_storage(filter);
+    benchmark_graph_updates(filter);
+    benchmark_cut_methods(filter, max_graph_size);
+
+    return 0;
+}
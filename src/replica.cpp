@@ -26,6 +26,7 @@
  */
 
 
+#include <event2/thread.h>
 #include <evpaxos.h>
 #include <evpaxos/paxos.h>
 
@@ -33,6 +34,7 @@
 #include <chrono>
 #include <iostream>
 #include <iterator>
+#include <memory>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string>
@@ -46,8 +48,15 @@
 
 #include "request/request_generation.h"
 #include "types/types.h"
+#include "scheduler/delivery_queue.h"
+#include "scheduler/message_pool.h"
+#include "scheduler/ordered_pipeline.hpp"
+#include "scheduler/read_index.h"
 #include "scheduler/scheduler.hpp"
+#include "scheduler/spin_wait.h"
 #include "graph/graph.hpp"
+#include "metrics/replica_metrics.h"
+#include "metrics/stage_tracer.h"
 
 
 using toml_config = toml::basic_value<
@@ -62,6 +71,12 @@ struct replica_args {
 	event_base* base;
 	event* signal;
 	kvpaxos::Scheduler<int>* scheduler;
+	kvpaxos::DeliveryQueue* delivery_queue;
+	kvpaxos::ReadIndex* read_index;
+	struct bufferevent* proposer;
+	event* marker_event;
+	event* read_event;
+	int read_socket;
 };
 
 static void
@@ -77,10 +92,195 @@ handle_sigint(int sig, short ev, void* arg)
 static void
 deliver(unsigned iid, char* value, size_t size, void* arg)
 {
-	auto* request = (struct client_message*)value;
 	auto* args = (struct replica_args*) arg;
-	auto* scheduler = args->scheduler;
-	scheduler->schedule_and_answer(*request);
+	args->delivery_queue->push(iid, value, size, metrics::read_tsc());
+}
+
+// a delivered value, decoded and planned ahead of being scheduled
+struct delivered_value {
+	unsigned instance;
+	std::string value;
+	uint64_t delivered_tsc;
+	std::vector<kvpaxos::MessageRef> commands;
+	std::vector<kvpaxos::dispatch_plan> plans;
+};
+
+static void
+decode_value(delivered_value& delivered)
+{
+	delivered.commands.clear();
+	const auto* value = delivered.value.data();
+	auto size = delivered.value.size();
+	auto iid = delivered.instance;
+
+	uint16_t n_commands;
+	auto offset = decode_batch_header(value, size, n_commands);
+	if (offset == 0) {
+		printf("Dropping malformed batch delivered at instance %u\n", iid);
+		return;
+	}
+
+	for (auto i = 0; i < n_commands; i++) {
+		auto request = kvpaxos::MessagePool::acquire();
+		auto n_bytes = decode_command(value + offset, size - offset, *request);
+		if (n_bytes == 0) {
+			printf("Dropping malformed command delivered at instance %u\n", iid);
+			return;
+		}
+		offset += n_bytes;
+		if (request->type != READ_INDEX) {
+			metrics::StageTracer::record(
+				metrics::DELIVERED, request->id, request->sin_port,
+				delivered.delivered_tsc
+			);
+		}
+		delivered.commands.push_back(std::move(request));
+	}
+}
+
+static void
+plan_value(delivered_value& delivered, kvpaxos::Scheduler<int>* scheduler)
+{
+	decode_value(delivered);
+	delivered.plans.clear();
+	for (const auto& request : delivered.commands) {
+		auto type = static_cast<request_type>(request->type);
+		if (type == READ or type == WRITE or type == SCAN) {
+			delivered.plans.push_back(scheduler->plan(*request));
+		} else {
+			delivered.plans.emplace_back();
+		}
+	}
+}
+
+/*
+	Reads the read index holder received directly, scheduled once the
+	marker covering them is delivered. They go after everything Paxos
+	ordered before the marker.
+*/
+static void
+schedule_local_reads(
+	kvpaxos::Scheduler<int>* scheduler, const std::vector<std::string>& reads)
+{
+	for (const auto& read : reads) {
+		uint16_t n_commands;
+		auto offset = decode_batch_header(read.data(), read.size(), n_commands);
+		auto request = kvpaxos::MessagePool::acquire();
+		if (offset == 0 or n_commands != 1 or decode_command(
+				read.data() + offset, read.size() - offset, *request) == 0)
+		{
+			printf("Dropping malformed local read\n");
+			continue;
+		}
+		scheduler->schedule_local_read(request);
+	}
+}
+
+// plans are optional, requests without one are mapped when scheduled
+static void
+schedule_value(
+	kvpaxos::Scheduler<int>* scheduler, kvpaxos::ReadIndex* read_index,
+	delivered_value& delivered)
+{
+	auto no_plan = kvpaxos::dispatch_plan();
+	for (auto i = 0; i < delivered.commands.size(); i++) {
+		const auto& request = delivered.commands[i];
+		const auto& plan = i < delivered.plans.size() ?
+			delivered.plans[i] : no_plan;
+		if (request->type == READ_INDEX) {
+			if (read_index != nullptr) {
+				std::vector<std::string> reads;
+				read_index->delivered(*request, reads);
+				schedule_local_reads(scheduler, reads);
+			}
+			continue;
+		}
+
+		scheduler->schedule_and_answer(request, plan);
+	}
+	// lets messages go back to the pool once executed
+	delivered.commands.clear();
+}
+
+/*
+	Schedules delivered values in order, off the learner's thread. With
+	n_workers, values are decoded and mapped to partitions by that many
+	threads ahead of the one scheduling them.
+*/
+static void
+dispatch_delivered_values(
+	kvpaxos::DeliveryQueue* delivery_queue, kvpaxos::Scheduler<int>* scheduler,
+	kvpaxos::ReadIndex* read_index, int n_workers, int window, int core)
+{
+	if (n_workers <= 0) {
+		kvpaxos::pin_current_thread(core);
+		delivered_value delivered;
+		while (delivery_queue->pop(
+			delivered.instance, delivered.value, delivered.delivered_tsc))
+		{
+			decode_value(delivered);
+			schedule_value(scheduler, read_index, delivered);
+		}
+		return;
+	}
+
+	kvpaxos::OrderedPipeline<delivered_value> pipeline(
+		window,
+		[delivery_queue](delivered_value& delivered) {
+			return delivery_queue->pop(
+				delivered.instance, delivered.value, delivered.delivered_tsc
+			);
+		},
+		[scheduler](delivered_value& delivered) {
+			plan_value(delivered, scheduler);
+		},
+		[scheduler, read_index](delivered_value& delivered) {
+			schedule_value(scheduler, read_index, delivered);
+		}
+	);
+	// pinned once the workers started, so they don't inherit its core
+	pipeline.run(n_workers, [core]() {
+		kvpaxos::pin_current_thread(core);
+	});
+}
+
+static void
+submit_read_marker(struct replica_args* args)
+{
+	struct command marker;
+	if (not args->read_index->next_marker(marker)) {
+		return;
+	}
+
+	char value[sizeof(struct batch_header) + MAX_ENCODED_COMMAND_SIZE];
+	auto size = encode_batch_header(1, value);
+	size += encode_command(marker, value + size);
+	paxos_submit(args->proposer, value, size);
+}
+
+/*
+	Submits markers again if they seem lost. Also activated when a marker
+	is delivered while reads wait for the next one.
+*/
+static void
+on_read_marker_timer(evutil_socket_t fd, short event, void* arg)
+{
+	submit_read_marker((struct replica_args*) arg);
+}
+
+// reads sent straight to the read index holder skip client batching
+static void
+receive_local_reads(evutil_socket_t fd, short event, void* arg)
+{
+	auto* args = (struct replica_args*) arg;
+	char value[sizeof(struct batch_header) + MAX_ENCODED_COMMAND_SIZE];
+	auto size = recv(fd, value, sizeof(value), 0);
+	if (size <= 0) {
+		return;
+	}
+
+	args->read_index->add_read(value, size);
+	submit_read_marker(args);
 }
 
 void
@@ -106,6 +306,9 @@ static struct evpaxos_replica*
 initialize_evpaxos_replica(int id, const toml_config& config)
 {
 	deliver_function cb = deliver;
+	// the dispatcher thread wakes the read index's marker event up, so the
+	// base must be created after enabling libevent's locking
+	evthread_use_pthreads();
 	auto* base = event_base_new();
 	auto paxos_config = toml::find<std::string>(config, "paxos_config");
 	auto* replica = evpaxos_replica_init(id, paxos_config.c_str(), cb, NULL, base);
@@ -122,6 +325,76 @@ initialize_evpaxos_replica(int id, const toml_config& config)
 	return replica;
 }
 
+static kvpaxos::ReadIndex*
+initialize_read_index(int id, const toml_config& config,
+	struct replica_args* args)
+{
+	auto holder_id = toml::find_or(config, "read_index_replica", -1);
+	if (holder_id < 0) {
+		return nullptr;
+	}
+	auto retry_timeout = toml::find_or(config, "read_index_retry", 1000000);
+	auto* read_index = new kvpaxos::ReadIndex(
+		holder_id, id, std::chrono::microseconds(retry_timeout)
+	);
+	if (not read_index->holder()) {
+		return read_index;
+	}
+
+	auto paxos_config = toml::find<std::string>(config, "paxos_config");
+	auto proposer_id = toml::find<int>(config, "proposer_id");
+	auto* conf = evpaxos_config_read(paxos_config.c_str());
+	if (conf == NULL) {
+		printf("Failed to read config file %s\n", paxos_config.c_str());
+		exit(1);
+	}
+	auto proposer_addr = evpaxos_proposer_address(conf, proposer_id);
+	args->proposer = bufferevent_socket_new(
+		args->base, -1, BEV_OPT_CLOSE_ON_FREE
+	);
+	bufferevent_enable(args->proposer, EV_READ|EV_WRITE);
+	bufferevent_socket_connect(
+		args->proposer, (struct sockaddr*) &proposer_addr,
+		sizeof(proposer_addr)
+	);
+	int flag = 1;
+	setsockopt(
+		bufferevent_getfd(args->proposer), IPPROTO_TCP, TCP_NODELAY,
+		&flag, sizeof(int)
+	);
+	evpaxos_config_free(conf);
+
+	args->read_socket = socket(AF_INET, SOCK_DGRAM, 0);
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(toml::find<int>(config, "read_index_port"));
+	if (bind(args->read_socket, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+		printf("Failed to bind the read index socket.\n");
+		exit(1);
+	}
+	evutil_make_socket_nonblocking(args->read_socket);
+	args->read_event = event_new(
+		args->base, args->read_socket, EV_READ|EV_PERSIST,
+		receive_local_reads, args
+	);
+	event_add(args->read_event, NULL);
+
+	args->marker_event = event_new(
+		args->base, -1, EV_PERSIST, on_read_marker_timer, args
+	);
+	auto interval_us = toml::find_or(config, "read_index_interval", 1000);
+	struct timeval interval = {interval_us / 1000000, interval_us % 1000000};
+	event_add(args->marker_event, &interval);
+	// the dispatcher thread delivers markers, the event loop submits them
+	read_index->set_reads_waiting_callback([args]() {
+		event_active(args->marker_event, EV_TIMEOUT, 1);
+	});
+
+	return read_index;
+}
+
 static kvpaxos::Scheduler<int>*
 initialize_scheduler(const toml_config& config)
 {
@@ -146,15 +419,61 @@ initialize_scheduler(const toml_config& config)
 	);
 	scheduler->populate_n_initial_keys(n_initial_keys);
 
+	auto partition_cores = toml::find_or(
+		config, "partition_cores", std::vector<int>()
+	);
+	auto spin_budget = toml::find_or(config, "spin_budget", 0);
+	scheduler->set_execution_mode(partition_cores, spin_budget);
+	scheduler->set_conflict_aware_sync(
+		toml::find_or(config, "conflict_aware_sync", false)
+	);
+
 	return scheduler;
 }
 
+static std::unique_ptr<metrics::MetricsExporter>
+make_metrics_exporter(
+	const toml_config& config, kvpaxos::Scheduler<int>* scheduler,
+	kvpaxos::DeliveryQueue* delivery_queue)
+{
+	auto metrics_path = toml::find_or(
+		config, "metrics_path", std::string("")
+	);
+	if (metrics_path.empty()) {
+		return nullptr;
+	}
+	auto metrics_interval = toml::find_or(config, "metrics_interval", 1000);
+	auto metrics_socket = toml::find_or(
+		config, "metrics_socket", std::string("")
+	);
+
+	return std::unique_ptr<metrics::MetricsExporter>(
+		new metrics::MetricsExporter(
+			[scheduler, delivery_queue]() {
+				auto sample = scheduler->sample_metrics();
+				sample.delivery_queue_depth = delivery_queue->size();
+				sample.n_delivery_stalls = delivery_queue->n_stalls();
+				return sample;
+			},
+			metrics_path, metrics_interval, metrics_socket
+		)
+	);
+}
+
 static void
 free_replica(struct evpaxos_replica* replica)
 {
 	auto* args = (struct replica_args*) replica->arg;
+	if (args->read_index != nullptr and args->read_index->holder()) {
+		event_free(args->marker_event);
+		event_free(args->read_event);
+		close(args->read_socket);
+		bufferevent_free(args->proposer);
+	}
+	delete args->read_index;
 	event_free(args->signal);
 	event_base_free(args->base);
+	delete args->delivery_queue;
 	delete args->scheduler;
 	free(args);
 	evpaxos_replica_free(replica);
@@ -177,6 +496,26 @@ start_replica(int id, const toml_config& config)
 	auto* args = (struct replica_args*) replica->arg;
 	args->scheduler = scheduler;
 
+	auto delivery_queue_size = toml::find_or(
+		config, "delivery_queue_size", DELIVERY_QUEUE_SIZE
+	);
+	args->delivery_queue = new kvpaxos::DeliveryQueue(
+		delivery_queue_size, 3 * delivery_queue_size / 4
+	);
+	args->delivery_queue->set_spin_budget(
+		toml::find_or(config, "spin_budget", 0)
+	);
+	args->read_index = initialize_read_index(id, config, args);
+	auto n_dispatch_workers = toml::find_or(config, "n_dispatch_workers", 0);
+	auto dispatch_window = toml::find_or(
+		config, "dispatch_window", DISPATCH_WINDOW
+	);
+	std::thread dispatcher_thread(
+		dispatch_delivered_values, args->delivery_queue, scheduler,
+		args->read_index, n_dispatch_workers, dispatch_window,
+		toml::find_or(config, "dispatcher_core", -1)
+	);
+
     auto n_total_requests = toml::find<int>(
         config, "n_requests"
     );
@@ -189,9 +528,31 @@ start_replica(int id, const toml_config& config)
 		print_throughput, n_total_requests, SLEEP, scheduler, args->base
 	);
 
+	auto trace_path = toml::find_or(config, "trace_path", std::string(""));
+	if (not trace_path.empty()) {
+		auto sample_period = toml::find_or(config, "trace_sample_period", 1024);
+		auto buffer_size = toml::find_or(config, "trace_buffer_size", 1 << 20);
+		metrics::StageTracer::enable(sample_period, buffer_size);
+	}
+
+	auto metrics_exporter = make_metrics_exporter(
+		config, scheduler, args->delivery_queue
+	);
+	if (metrics_exporter != nullptr) {
+		metrics_exporter->start();
+	}
+
 	event_base_loop(args->base, EVLOOP_NO_EXIT_ON_EMPTY);
 
 	throughput_thread.join();
+	args->delivery_queue->close();
+	dispatcher_thread.join();
+	if (metrics_exporter != nullptr) {
+		metrics_exporter->stop();
+	}
+	if (not trace_path.empty()) {
+		metrics::StageTracer::dump(trace_path);
+	}
 	free_replica(replica);
 }
 
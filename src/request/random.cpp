@@ -41,4 +41,86 @@ RandFunction ranged_binomial_distribution(
     };
 }
 
+RandFunction zipfian_distribution(
+    int n_items, double zipfian_constant, unsigned seed
+) {
+    auto theta = zipfian_constant;
+    auto zetan = 0.0;
+    for (auto i = 1; i <= n_items; i++) {
+        zetan += 1 / std::pow(i, theta);
+    }
+    auto zeta2 = 1 + std::pow(0.5, theta);
+    auto alpha = 1 / (1 - theta);
+    auto eta = (1 - std::pow(2.0 / n_items, 1 - theta)) / (1 - zeta2 / zetan);
+
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    return [=]() mutable {
+        auto u = distribution(generator);
+        auto uz = u * zetan;
+        if (uz < 1.0) {
+            return 0;
+        }
+        if (uz < zeta2) {
+            return std::min(1, n_items - 1);
+        }
+        auto value = (int) (n_items * std::pow(eta*u - eta + 1, alpha));
+        return std::min(value, n_items - 1);
+    };
+}
+
+uint64_t fnv_hash(uint64_t value) {
+    const uint64_t offset_basis = 0xCBF29CE484222325ull;
+    const uint64_t prime = 1099511628211ull;
+
+    auto hash = offset_basis;
+    for (auto i = 0; i < 8; i++) {
+        hash ^= value & 0xff;
+        hash *= prime;
+        value >>= 8;
+    }
+    return hash;
+}
+
+RandFunction scrambled_zipfian_distribution(
+    int n_items, double zipfian_constant, unsigned seed
+) {
+    auto zipfian = zipfian_distribution(n_items, zipfian_constant, seed);
+    return [zipfian, n_items]() {
+        return (int) (fnv_hash(zipfian()) % n_items);
+    };
+}
+
+RandFunction latest_distribution(
+    std::shared_ptr<int> latest_item, int n_items, double zipfian_constant,
+    unsigned seed
+) {
+    auto zipfian = zipfian_distribution(n_items, zipfian_constant, seed);
+    return [zipfian, latest_item]() {
+        return std::max(0, *latest_item - zipfian());
+    };
+}
+
+RandFunction hotspot_distribution(
+    int min_value, int max_value, double hot_set_fraction,
+    double hot_operation_fraction, unsigned seed
+) {
+    auto n_values = max_value - min_value + 1;
+    auto hot_set_size = std::max(1, (int) (n_values * hot_set_fraction));
+    auto last_hot_value = min_value + hot_set_size - 1;
+
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> operation(0.0, 1.0);
+    std::uniform_int_distribution<int> hot_value(min_value, last_hot_value);
+    std::uniform_int_distribution<int> cold_value(
+        std::min(last_hot_value + 1, max_value), max_value
+    );
+    return [=]() mutable {
+        if (operation(generator) < hot_operation_fraction) {
+            return hot_value(generator);
+        }
+        return cold_value(generator);
+    };
+}
+
 }
@@ -1,19 +1,28 @@
 #ifndef RFUNC_RANDOM_H
 #define RFUNC_RANDOM_H
 
+#include <cmath>
 #include <functional>
+#include <memory>
 #include <random>
+#include <string>
 #include <unordered_map>
 
 namespace rfunc {
 
 typedef std::function<int()> RandFunction;
 
-enum Distribution {FIXED, UNIFORM, BINOMIAL};
+enum Distribution {
+    FIXED, UNIFORM, BINOMIAL, ZIPFIAN, SCRAMBLED_ZIPFIAN, LATEST, HOTSPOT
+};
 const std::unordered_map<std::string, Distribution> string_to_distribution({
     {"FIXED", Distribution::FIXED},
     {"UNIFORM", Distribution::UNIFORM},
-    {"BINOMIAL", Distribution::BINOMIAL}
+    {"BINOMIAL", Distribution::BINOMIAL},
+    {"ZIPFIAN", Distribution::ZIPFIAN},
+    {"SCRAMBLED_ZIPFIAN", Distribution::SCRAMBLED_ZIPFIAN},
+    {"LATEST", Distribution::LATEST},
+    {"HOTSPOT", Distribution::HOTSPOT}
 });
 
 RandFunction uniform_distribution_rand(int min_value, int max_value);
@@ -25,6 +34,33 @@ RandFunction ranged_binomial_distribution(
     int min_value, int n_experiments, double success_probability
 );
 
+/*
+The following distributions mirror YCSB's key choosers. They take a seed so
+generated workloads can be reproduced.
+*/
+
+// Values in [0, n_items), 0 being the most popular, as in Gray et al.
+// "Quickly generating billion-record synthetic databases".
+RandFunction zipfian_distribution(
+    int n_items, double zipfian_constant, unsigned seed
+);
+// Zipfian popularity with popular values hashed all over [0, n_items).
+RandFunction scrambled_zipfian_distribution(
+    int n_items, double zipfian_constant, unsigned seed
+);
+// Zipfian popularity counted backwards from *latest_item, which the caller
+// keeps updated with the most recently inserted value.
+RandFunction latest_distribution(
+    std::shared_ptr<int> latest_item, int n_items, double zipfian_constant,
+    unsigned seed
+);
+// hot_operation_fraction of the values fall uniformly in the first
+// hot_set_fraction of [min_value, max_value], the rest in the remainder.
+RandFunction hotspot_distribution(
+    int min_value, int max_value, double hot_set_fraction,
+    double hot_operation_fraction, unsigned seed
+);
+
 }
 
 #endif
@@ -3,19 +3,20 @@
 
 namespace workload {
 
-Request make_request(char* type_buffer, char* key_buffer, char* arg_buffer) {
+void emit_cs_request(
+    char* type_buffer, char* key_buffer, char* arg_buffer,
+    const cs_request_callback& callback)
+{
     auto type = static_cast<request_type>(std::stoi(type_buffer));
     auto key = std::stoi(key_buffer);
-    auto arg = std::string(arg_buffer);
-
-    return Request(type, key, arg);
+    callback(type, key, arg_buffer);
 }
 
-std::vector<Request> import_cs_requests(const std::string& file_path)
+void for_each_cs_request(
+    const std::string& file_path, const cs_request_callback& callback)
 {
     std::ifstream infile(file_path);
 
-    std::vector<Request> requests;
     std::string line;
     char type_buffer[2];
     char key_buffer[11];
@@ -32,11 +33,9 @@ std::vector<Request> import_cs_requests(const std::string& file_path)
                     reading_buffer = arg_buffer;
                 } else {
                     reading_buffer = type_buffer;
-                    requests.emplace_back(make_request(
-                        type_buffer,
-                        key_buffer,
-                        arg_buffer
-                    ));
+                    emit_cs_request(
+                        type_buffer, key_buffer, arg_buffer, callback
+                    );
                 }
                 buffer_index = 0;
             } else {
@@ -46,8 +45,17 @@ std::vector<Request> import_cs_requests(const std::string& file_path)
         }
     }
     reading_buffer[buffer_index] = '\0';
-    requests.emplace_back(make_request(type_buffer, key_buffer, arg_buffer));
+    emit_cs_request(type_buffer, key_buffer, arg_buffer, callback);
+}
 
+std::vector<Request> import_cs_requests(const std::string& file_path)
+{
+    std::vector<Request> requests;
+    for_each_cs_request(file_path,
+        [&requests](request_type type, int key, const char* args) {
+            requests.emplace_back(type, key, std::string(args));
+        }
+    );
     return requests;
 }
 
@@ -17,8 +17,14 @@ namespace workload {
 
 typedef toml::basic_value<toml::discard_comments, std::unordered_map> toml_config;
 
+typedef std::function<void(request_type type, int key, const char* args)>
+    cs_request_callback;
+
 std::vector<Request> import_requests(const std::string& file_path, const std::string& field);
 std::vector<Request> import_cs_requests(const std::string& file_path);
+void for_each_cs_request(
+    const std::string& file_path, const cs_request_callback& callback
+);
 
 /*
 Those generations were made for a simpler execution that doesn't differentiate
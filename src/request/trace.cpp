@@ -0,0 +1,209 @@
+#include "trace.h"
+
+
+namespace workload {
+
+trace_record make_trace_record(request_type type, int key, const char* args)
+{
+    trace_record record;
+    record.key = key;
+    record.type = type;
+    record.reserved = 0;
+    record.arg = 0;
+    if (type == SCAN) {
+        record.arg = strtol(args, nullptr, 10);
+    } else if (type == WRITE) {
+        record.arg = strlen(args);
+    }
+    return record;
+}
+
+void fill_command(const trace_record& record, int id, struct command& command,
+    const char* value)
+{
+    command.id = id;
+    command.type = record.type;
+    command.key = record.key;
+    command.scan_length = 0;
+    command.value_size = 0;
+    if (record.type == SCAN) {
+        command.scan_length = record.arg;
+    } else if (record.type == WRITE) {
+        command.value_size = record.arg == 0 ?
+            VALUE_SIZE : std::min<int>(record.arg, VALUE_SIZE);
+        if (value != nullptr) {
+            memcpy(command.value, value, command.value_size);
+        } else {
+            memset(command.value, '#', command.value_size);
+        }
+    }
+}
+
+Trace::Trace(Trace&& other) {
+    *this = std::move(other);
+}
+
+Trace& Trace::operator=(Trace&& other) {
+    if (this == &other) {
+        return *this;
+    }
+
+    release();
+    mapping_ = other.mapping_;
+    mapping_size_ = other.mapping_size_;
+    owned_records_ = std::move(other.owned_records_);
+    values_ = std::move(other.values_);
+    n_records_ = other.n_records_;
+    if (mapping_ != nullptr) {
+        records_ = other.records_;
+    } else {
+        records_ = owned_records_.data();
+    }
+
+    other.mapping_ = nullptr;
+    other.mapping_size_ = 0;
+    other.records_ = nullptr;
+    other.n_records_ = 0;
+    return *this;
+}
+
+Trace::~Trace() {
+    release();
+}
+
+void Trace::release() {
+    if (mapping_ != nullptr) {
+        munmap(mapping_, mapping_size_);
+        mapping_ = nullptr;
+    }
+}
+
+Trace Trace::load(const std::string& file_path) {
+    if (is_binary_trace(file_path)) {
+        return map(file_path);
+    }
+
+    std::vector<trace_record> records;
+    std::vector<std::string> values;
+    for_each_cs_request(file_path,
+        [&records, &values](request_type type, int key, const char* args) {
+            records.emplace_back(make_trace_record(type, key, args));
+            values.emplace_back(type == WRITE ? args : "");
+        }
+    );
+    auto trace = from_records(std::move(records));
+    trace.values_ = std::move(values);
+    return trace;
+}
+
+Trace Trace::map(const std::string& file_path) {
+    auto fd = open(file_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open trace " + file_path);
+    }
+
+    struct stat file_stat;
+    fstat(fd, &file_stat);
+    auto size = static_cast<std::size_t>(file_stat.st_size);
+    if (size < sizeof(trace_header)) {
+        ::close(fd);
+        throw std::runtime_error("Truncated trace " + file_path);
+    }
+
+    auto* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Could not map trace " + file_path);
+    }
+    madvise(mapping, size, MADV_SEQUENTIAL);
+
+    const auto* header = static_cast<const trace_header*>(mapping);
+    auto records_size = size - sizeof(trace_header);
+    if (header->magic != TRACE_MAGIC or header->version != TRACE_VERSION or
+        header->record_size != sizeof(trace_record) or
+        header->n_records > records_size / sizeof(trace_record))
+    {
+        munmap(mapping, size);
+        throw std::runtime_error("Invalid trace " + file_path);
+    }
+
+    Trace trace;
+    trace.mapping_ = mapping;
+    trace.mapping_size_ = size;
+    trace.records_ = reinterpret_cast<const trace_record*>(header + 1);
+    trace.n_records_ = header->n_records;
+    return trace;
+}
+
+Trace Trace::from_records(std::vector<trace_record> records) {
+    Trace trace;
+    trace.owned_records_ = std::move(records);
+    trace.records_ = trace.owned_records_.data();
+    trace.n_records_ = trace.owned_records_.size();
+    return trace;
+}
+
+bool is_binary_trace(const std::string& file_path) {
+    auto* file = fopen(file_path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    uint32_t magic = 0;
+    auto n_read = fread(&magic, sizeof(magic), 1, file);
+    fclose(file);
+    return n_read == 1 and magic == TRACE_MAGIC;
+}
+
+TraceWriter::TraceWriter(const std::string& file_path)
+    : file_path_{file_path}
+{
+    file_ = fopen(file_path.c_str(), "wb");
+    if (file_ == nullptr) {
+        throw std::runtime_error("Could not create trace " + file_path);
+    }
+
+    trace_header header{TRACE_MAGIC, TRACE_VERSION, sizeof(trace_record), 0};
+    if (fwrite(&header, sizeof(header), 1, file_) != 1) {
+        fclose(file_);
+        file_ = nullptr;
+        throw std::runtime_error("Could not write trace " + file_path);
+    }
+}
+
+// a destroyed writer that wasn't closed can't report failures anymore
+TraceWriter::~TraceWriter() {
+    if (file_ != nullptr) {
+        finish();
+    }
+}
+
+void TraceWriter::write(const trace_record& record) {
+    if (fwrite(&record, sizeof(record), 1, file_) != 1) {
+        throw std::runtime_error("Could not write trace " + file_path_);
+    }
+    n_records_++;
+}
+
+void TraceWriter::close() {
+    if (file_ == nullptr) {
+        return;
+    }
+    if (not finish()) {
+        throw std::runtime_error("Could not write trace " + file_path_);
+    }
+}
+
+// fixes the header's record count and closes the file, whether it worked
+bool TraceWriter::finish() {
+    trace_header header{
+        TRACE_MAGIC, TRACE_VERSION, sizeof(trace_record), n_records_
+    };
+    auto written = fseek(file_, 0, SEEK_SET) == 0 and
+        fwrite(&header, sizeof(header), 1, file_) == 1;
+    auto closed = fclose(file_) == 0;
+    file_ = nullptr;
+    return written and closed;
+}
+
+}
@@ -0,0 +1,123 @@
+#ifndef WORKLOAD_TRACE_H
+#define WORKLOAD_TRACE_H
+
+#include <chrono>
+#include <cstdint>
+#include <fcntl.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "request.hpp"
+#include "request_generation.h"
+
+namespace workload {
+
+/*
+A binary trace is a header followed by fixed size records, one per request.
+A record's arg is the scan length of SCANs and the value size of WRITEs,
+where 0 means VALUE_SIZE; written values themselves are not kept.
+*/
+const uint32_t TRACE_MAGIC = 0x5254564b;  // "KVTR" on disk
+const uint16_t TRACE_VERSION = 1;
+
+struct __attribute__((packed)) trace_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint64_t n_records;
+};
+
+struct __attribute__((packed)) trace_record {
+    int32_t key;
+    uint8_t type;
+    uint8_t reserved;
+    uint16_t arg;
+};
+
+trace_record make_trace_record(request_type type, int key, const char* args);
+// fills all of command's fields but the reply address, a WRITE without
+// its value given writes a VALUE_SIZE bounded run of '#'
+void fill_command(const trace_record& record, int id, struct command& command,
+    const char* value = nullptr);
+
+class Trace {
+public:
+    Trace() = default;
+    Trace(Trace&& other);
+    Trace& operator=(Trace&& other);
+    Trace(const Trace&) = delete;
+    Trace& operator=(const Trace&) = delete;
+    ~Trace();
+
+    // Binary traces are memory mapped, comma separated files are read
+    // into memory.
+    static Trace load(const std::string& file_path);
+    static Trace map(const std::string& file_path);
+    static Trace from_records(std::vector<trace_record> records);
+
+    std::size_t size() const {return n_records_;}
+    const trace_record& operator[](std::size_t index) const {
+        return records_[index];
+    }
+    const trace_record* begin() const {return records_;}
+    const trace_record* end() const {return records_ + n_records_;}
+    // written value of the record at index, nullptr unless read from a
+    // comma separated file
+    const char* value(std::size_t index) const {
+        if (values_.empty() or values_[index].empty()) {
+            return nullptr;
+        }
+        return values_[index].c_str();
+    }
+
+private:
+    void release();
+
+    void* mapping_{nullptr};
+    std::size_t mapping_size_{0};
+    std::vector<trace_record> owned_records_;
+    std::vector<std::string> values_;
+    const trace_record* records_{nullptr};
+    std::size_t n_records_{0};
+};
+
+bool is_binary_trace(const std::string& file_path);
+
+// steady clock time requests are stamped with when sent and answered
+inline int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+/*
+Writes records to a binary trace incrementally, so traces larger than
+memory can be produced. The header's record count is fixed on close().
+Failing writes throw std::runtime_error.
+*/
+class TraceWriter {
+public:
+    TraceWriter(const std::string& file_path);
+    ~TraceWriter();
+
+    void write(const trace_record& record);
+    void close();
+
+private:
+    bool finish();
+
+    std::string file_path_;
+    FILE* file_;
+    uint64_t n_records_{0};
+};
+
+}
+
+#endif
@@ -0,0 +1,215 @@
+#include "workload_generator.h"
+
+#include <stdexcept>
+
+
+namespace workload {
+
+WorkloadGenerator::WorkloadGenerator(
+    int n_keys, std::vector<workload_phase> phases, unsigned seed)
+    : n_keys_{n_keys},
+      phases_{std::move(phases)},
+      seed_{seed},
+      generator_(seed),
+      insert_(0.0, 1.0),
+      latest_key_{std::make_shared<int>(n_keys - 1)}
+{
+    for (const auto& phase : phases_) {
+        n_records_ += phase.n_requests;
+    }
+}
+
+bool WorkloadGenerator::next(trace_record& record) {
+    while (remaining_in_phase_ == 0) {
+        if (current_phase_ + 1 == phases_.size()) {
+            return false;
+        }
+        start_phase(current_phase_ + 1);
+    }
+    remaining_in_phase_--;
+
+    const auto& phase = phases_[current_phase_];
+    auto type = static_cast<request_type>(operation_(generator_));
+    record.type = type;
+    record.reserved = 0;
+    record.arg = 0;
+    if (type == SCAN) {
+        record.arg = scan_length_rand_();
+        record.key = next_key(record.arg);
+    } else if (type == WRITE and insert_(generator_) < phase.insert_proportion) {
+        *latest_key_ += 1;
+        record.key = *latest_key_;
+    } else {
+        record.key = next_key(1);
+    }
+    return true;
+}
+
+void WorkloadGenerator::start_phase(int phase_index) {
+    current_phase_ = phase_index;
+    const auto& phase = phases_[phase_index];
+    remaining_in_phase_ = phase.n_requests;
+
+    // request_type values index the weights: READ, WRITE, SCAN
+    operation_ = std::discrete_distribution<int>({
+        phase.read_proportion, phase.write_proportion, phase.scan_proportion
+    });
+
+    auto seed = seed_ + phase_index;
+    switch (phase.key_distribution) {
+    case rfunc::ZIPFIAN:
+        key_rand_ = rfunc::zipfian_distribution(
+            n_keys_, phase.zipfian_constant, seed
+        );
+        break;
+    case rfunc::SCRAMBLED_ZIPFIAN:
+        key_rand_ = rfunc::scrambled_zipfian_distribution(
+            n_keys_, phase.zipfian_constant, seed
+        );
+        break;
+    case rfunc::LATEST:
+        key_rand_ = rfunc::latest_distribution(
+            latest_key_, n_keys_, phase.zipfian_constant, seed
+        );
+        break;
+    case rfunc::HOTSPOT:
+        key_rand_ = rfunc::hotspot_distribution(
+            0, n_keys_ - 1, phase.hot_set_fraction,
+            phase.hot_operation_fraction, seed
+        );
+        break;
+    default:
+        key_rand_ = rfunc::uniform_distribution_rand(0, n_keys_ - 1);
+        break;
+    }
+
+    auto max_scan_length = std::max(
+        1, std::min(phase.max_scan_length, MAX_SCAN_LENGTH)
+    );
+    switch (phase.scan_length_distribution) {
+    case rfunc::FIXED:
+        scan_length_rand_ = rfunc::fixed_distribution(max_scan_length);
+        break;
+    case rfunc::ZIPFIAN:
+    {
+        auto zipfian = rfunc::zipfian_distribution(
+            max_scan_length, phase.zipfian_constant, seed
+        );
+        scan_length_rand_ = [zipfian]() {return zipfian() + 1;};
+        break;
+    }
+    default:
+        scan_length_rand_ = rfunc::uniform_distribution_rand(
+            1, max_scan_length
+        );
+        break;
+    }
+}
+
+int WorkloadGenerator::next_key(int scan_length) {
+    // LATEST already follows inserted keys, others are rotated by the
+    // phase's shift and kept inside the initial keys so scans don't
+    // run past the last one
+    const auto& phase = phases_[current_phase_];
+    auto key = key_rand_();
+    if (phase.key_distribution == rfunc::LATEST) {
+        return key;
+    }
+
+    key = (key + phase.hot_set_shift) % n_keys_;
+    return std::min(key, std::max(0, n_keys_ - scan_length));
+}
+
+std::vector<workload_phase> import_workload_phases(
+    const toml_config& config)
+{
+    auto phases_config = toml::find<std::vector<toml_config>>(
+        config, "phases"
+    );
+
+    std::vector<workload_phase> phases;
+    for (const auto& phase_config : phases_config) {
+        workload_phase phase;
+        phase.n_requests = toml::find<int>(phase_config, "n_requests");
+        phase.read_proportion = toml::find_or(
+            phase_config, "read_proportion", 0.95
+        );
+        phase.write_proportion = toml::find_or(
+            phase_config, "write_proportion", 0.05
+        );
+        phase.scan_proportion = toml::find_or(
+            phase_config, "scan_proportion", 0.0
+        );
+        phase.insert_proportion = toml::find_or(
+            phase_config, "insert_proportion", 0.0
+        );
+        phase.key_distribution = rfunc::string_to_distribution.at(
+            toml::find_or(
+                phase_config, "key_distribution", std::string("ZIPFIAN")
+            )
+        );
+        phase.zipfian_constant = toml::find_or(
+            phase_config, "zipfian_constant", 0.99
+        );
+        // the zipfian generators divide by 1 - zipfian_constant
+        if (phase.zipfian_constant <= 0 or phase.zipfian_constant >= 1) {
+            throw std::invalid_argument(
+                "zipfian_constant must be between 0 and 1, exclusive"
+            );
+        }
+        phase.hot_set_fraction = toml::find_or(
+            phase_config, "hot_set_fraction", 0.2
+        );
+        phase.hot_operation_fraction = toml::find_or(
+            phase_config, "hot_operation_fraction", 0.8
+        );
+        phase.hot_set_shift = toml::find_or(phase_config, "hot_set_shift", 0);
+        phase.scan_length_distribution = rfunc::string_to_distribution.at(
+            toml::find_or(
+                phase_config, "scan_length_distribution",
+                std::string("UNIFORM")
+            )
+        );
+        phase.max_scan_length = toml::find_or(
+            phase_config, "max_scan_length", MAX_SCAN_LENGTH
+        );
+        // replicas refuse longer scans
+        if (phase.max_scan_length < 1 or
+            phase.max_scan_length > MAX_SCAN_LENGTH)
+        {
+            throw std::invalid_argument(
+                "max_scan_length must be between 1 and " +
+                std::to_string(MAX_SCAN_LENGTH)
+            );
+        }
+        phases.push_back(phase);
+    }
+    return phases;
+}
+
+WorkloadGenerator make_workload_generator(
+    const toml_config& config, unsigned seed_offset)
+{
+    const auto& workload_config = toml::find(config, "workload");
+    auto n_keys = toml::find<int>(workload_config, "n_keys");
+    auto seed = toml::find_or(workload_config, "seed", 0);
+    return WorkloadGenerator(
+        n_keys, import_workload_phases(workload_config), seed + seed_offset
+    );
+}
+
+Trace load_requests(const toml_config& config) {
+    if (not config.contains("workload")) {
+        return Trace::load(toml::find<std::string>(config, "requests_path"));
+    }
+
+    auto generator = make_workload_generator(config);
+    std::vector<trace_record> records;
+    trace_record record;
+    while (generator.next(record)) {
+        records.push_back(record);
+    }
+    return Trace::from_records(std::move(records));
+}
+
+}
@@ -0,0 +1,81 @@
+#ifndef WORKLOAD_WORKLOAD_GENERATOR_H
+#define WORKLOAD_WORKLOAD_GENERATOR_H
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <toml11/toml.hpp>
+#include "constants/constants.h"
+#include "random.h"
+#include "request_generation.h"
+#include "trace.h"
+
+namespace workload {
+
+/*
+A phase of a YCSB-like workload. Proportions are relative to each other,
+insert_proportion is the fraction of WRITEs that create a new key past the
+last one. Keys are rotated by hot_set_shift, so consecutive phases with
+different shifts move the hot set around the key space.
+*/
+struct workload_phase {
+    int n_requests;
+    double read_proportion;
+    double write_proportion;
+    double scan_proportion;
+    double insert_proportion;
+    rfunc::Distribution key_distribution;
+    double zipfian_constant;
+    double hot_set_fraction;
+    double hot_operation_fraction;
+    int hot_set_shift;
+    rfunc::Distribution scan_length_distribution;
+    int max_scan_length;
+};
+
+/*
+Streams the records of a workload made of consecutive phases, without
+keeping them in memory.
+*/
+class WorkloadGenerator {
+public:
+    WorkloadGenerator(
+        int n_keys, std::vector<workload_phase> phases, unsigned seed
+    );
+
+    bool next(trace_record& record);
+    std::size_t size() const {return n_records_;}
+
+private:
+    void start_phase(int phase_index);
+    int next_key(int scan_length);
+
+    int n_keys_;
+    std::vector<workload_phase> phases_;
+    unsigned seed_;
+    std::mt19937 generator_;
+    std::discrete_distribution<int> operation_;
+    std::uniform_real_distribution<double> insert_;
+    std::shared_ptr<int> latest_key_;
+    rfunc::RandFunction key_rand_;
+    rfunc::RandFunction scan_length_rand_;
+
+    int current_phase_{-1};
+    int remaining_in_phase_{0};
+    std::size_t n_records_{0};
+};
+
+std::vector<workload_phase> import_workload_phases(
+    const toml_config& config
+);
+WorkloadGenerator make_workload_generator(
+    const toml_config& config, unsigned seed_offset = 0
+);
+// all requests of a [workload] table, or of requests_path without one
+Trace load_requests(const toml_config& config);
+
+}
+
+#endif
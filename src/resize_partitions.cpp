@@ -0,0 +1,74 @@
+#include <evpaxos.h>
+#include <iostream>
+#include <string>
+
+#include <toml11/toml.hpp>
+#include "evclient/evclient.h"
+#include "types/types.h"
+
+
+static int n_partitions;
+
+static void
+on_written(struct bufferevent* bev, void* arg)
+{
+    auto* client = (struct client*) arg;
+    event_base_loopexit(client->base, NULL);
+}
+
+static void
+on_connect(struct bufferevent* bev, short events, void* arg)
+{
+    auto* client = (struct client*) arg;
+    if (not (events & BEV_EVENT_CONNECTED)) {
+        printf("Failed to connect to the proposer\n");
+        event_base_loopexit(client->base, NULL);
+        return;
+    }
+
+    struct command resize;
+    memset(&resize, 0, sizeof(resize));
+    resize.type = RESIZE;
+    resize.key = n_partitions;
+
+    auto size = encode_batch_header(1, client->send_buffer);
+    size += encode_command(resize, client->send_buffer + size);
+    bufferevent_setcb(bev, NULL, on_written, on_connect, client);
+    paxos_submit(bev, client->send_buffer, size);
+}
+
+static void
+usage(std::string prog)
+{
+    std::cout << "Usage: " << prog << " config n_partitions\n";
+}
+
+int
+main(int argc, char const *argv[])
+{
+    if (argc < 3) {
+        usage(std::string(argv[0]));
+        exit(1);
+    }
+
+    const auto config = toml::parse(argv[1]);
+    n_partitions = atoi(argv[2]);
+    if (n_partitions < 1) {
+        usage(std::string(argv[0]));
+        exit(1);
+    }
+
+    auto paxos_config = toml::find<std::string>(config, "paxos_config");
+    auto proposer_id = toml::find<int>(config, "proposer_id");
+    auto* client = make_client(
+        paxos_config.c_str(), proposer_id, 1, batch_buffer_size(1),
+        on_connect, nullptr
+    );
+    if (client == nullptr) {
+        exit(1);
+    }
+    event_base_dispatch(client->base);
+    client_free(client);
+
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include "delivery_queue.h"
+
+#include <stdio.h>
+
+#include "spin_wait.h"
+
+
+namespace kvpaxos {
+
+DeliveryQueue::DeliveryQueue(std::size_t capacity, std::size_t high_watermark)
+    : values_(std::max<std::size_t>(capacity, 1)),
+      high_watermark_{std::min(high_watermark, values_.size())}
+{}
+
+void DeliveryQueue::push(unsigned instance, const char* value,
+    std::size_t size, uint64_t delivered_tsc)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (size_ == values_.size()) {
+        n_stalls_++;
+        not_full_.wait(lock, [this] {
+            return size_ < values_.size() or closed_;
+        });
+    }
+    if (closed_) {
+        return;
+    }
+
+    // slots keep their strings, so their buffers are reused
+    auto& slot = values_[tail_];
+    slot.instance = instance;
+    slot.value.assign(value, size);
+    slot.delivered_tsc = delivered_tsc;
+    tail_ = (tail_ + 1) % values_.size();
+    size_++;
+
+    if (size_ >= high_watermark_) {
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_report_ >= std::chrono::seconds(1)) {
+            last_report_ = now;
+            // stdout carries the replica's throughput CSV
+            fprintf(
+                stderr,
+                "Delivery queue holds %zu values, scheduler is falling behind\n",
+                size_.load()
+            );
+        }
+    }
+    lock.unlock();
+    not_empty_.notify_one();
+}
+
+bool DeliveryQueue::pop(
+    unsigned& instance, std::string& value, uint64_t& delivered_tsc)
+{
+    for (auto i = 0; i < spin_budget_ and size_ == 0; i++) {
+        cpu_relax();
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this] {return size_ > 0 or closed_;});
+    if (size_ == 0) {
+        return false;
+    }
+
+    auto& slot = values_[head_];
+    instance = slot.instance;
+    value.swap(slot.value);
+    delivered_tsc = slot.delivered_tsc;
+    head_ = (head_ + 1) % values_.size();
+    size_--;
+    lock.unlock();
+    not_full_.notify_one();
+    return true;
+}
+
+void DeliveryQueue::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+    }
+    not_empty_.notify_all();
+    not_full_.notify_all();
+}
+
+}
@@ -0,0 +1,63 @@
+#ifndef KVPAXOS_DELIVERY_QUEUE_H
+#define KVPAXOS_DELIVERY_QUEUE_H
+
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+namespace kvpaxos {
+
+/*
+    Bounded FIFO of values delivered by Paxos, kept in delivery order. The
+    learner pushes and a single dispatcher thread pops, so scheduler stalls
+    don't hold up the learner until the queue fills up. A full queue blocks
+    push(), which stops the learner and pushes the backpressure to Paxos;
+    holding more than high_watermark values is reported, at most once a
+    second, so it shows up before that happens.
+*/
+class DeliveryQueue {
+public:
+    DeliveryQueue(std::size_t capacity, std::size_t high_watermark);
+
+    // delivered_tsc is when Paxos delivered the value, for stage traces
+    void push(unsigned instance, const char* value, std::size_t size,
+        uint64_t delivered_tsc);
+    // swaps the oldest value into value, returns false once the queue is
+    // closed and empty
+    bool pop(unsigned& instance, std::string& value, uint64_t& delivered_tsc);
+    void close();
+    // polls an empty queue spin_budget times before sleeping on it
+    void set_spin_budget(int spin_budget) {spin_budget_ = spin_budget;}
+
+    std::size_t size() const {return size_;}
+    uint64_t n_stalls() const {return n_stalls_;}
+
+private:
+    struct delivered_value {
+        unsigned instance;
+        std::string value;
+        uint64_t delivered_tsc;
+    };
+
+    std::vector<delivered_value> values_;
+    std::size_t head_{0}, tail_{0};
+    std::atomic<std::size_t> size_{0};
+    std::size_t high_watermark_;
+    std::chrono::steady_clock::time_point last_report_;
+    bool closed_{false};
+    int spin_budget_{0};
+    std::atomic<uint64_t> n_stalls_{0};
+
+    std::mutex mutex_;
+    std::condition_variable not_empty_, not_full_;
+};
+
+}
+
+#endif
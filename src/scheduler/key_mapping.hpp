@@ -0,0 +1,219 @@
+#ifndef KVPAXOS_KEY_MAPPING_H
+#define KVPAXOS_KEY_MAPPING_H
+
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "graph/partitioning.h"
+#include "key_ranges.hpp"
+#include "partition_set.h"
+#include "types/types.h"
+
+
+namespace kvpaxos {
+
+/*
+    Partition each key is mapped to. New keys are given round robin, or to
+    the range they fall in with RANGE, until a cut of the workload graph is
+    assigned. The Scheduler and the partitioning evaluator share it, so
+    both map requests the same way; it takes no locks of its own.
+*/
+template <typename T>
+class KeyMapping {
+public:
+    KeyMapping(int n_partitions, model::CutMethod method)
+        : n_partitions_{n_partitions},
+          method_{method}
+    {}
+
+    // maps keys 0 to n_keys-1, evenly split into ranges with RANGE
+    void populate_n_initial_keys(int n_keys) {
+        if (method_ == model::RANGE) {
+            key_ranges_.split_evenly(0, n_keys, n_partitions_);
+        }
+        for (auto i = 0; i < n_keys; i++) {
+            add_key(i);
+        }
+    }
+
+    // returns the partition the new key was mapped to
+    int add_key(T key) {
+        if (method_ == model::RANGE) {
+            auto partition_id = key_ranges_.partition(key);
+            data_to_partition_id_.emplace(key, partition_id);
+            add_mapped_interval(key);
+            return partition_id;
+        }
+
+        auto partition_id = round_robin_counter_;
+        data_to_partition_id_.emplace(key, partition_id);
+        round_robin_counter_ = (round_robin_counter_+1) % n_partitions_;
+        return partition_id;
+    }
+
+    bool mapped(T key) const {
+        return data_to_partition_id_.find(key) != data_to_partition_id_.end();
+    }
+
+    int partition(T key) const {
+        return data_to_partition_id_.at(key);
+    }
+
+    const std::unordered_map<T, int>& data_to_partition_id() const {
+        return data_to_partition_id_;
+    }
+
+    // empty unless every key the request accesses is mapped
+    PartitionSet involved_partitions(const struct command& request) const {
+        PartitionSet involved_partitions_ids;
+        auto type = static_cast<request_type>(request.type);
+
+        auto range = 1;
+        if (type == SCAN) {
+            range = request.scan_length;
+        }
+
+        // both lookups are binary searches, whatever the scan's length
+        if (method_ == model::RANGE) {
+            auto last = request.key + range - 1;
+            if (range <= 0 or not all_mapped(request.key, last)) {
+                return PartitionSet();
+            }
+            return key_ranges_.partitions(request.key, last);
+        }
+
+        for (auto i = 0; i < range; i++) {
+            auto it = data_to_partition_id_.find(request.key + i);
+            if (it == data_to_partition_id_.end()) {
+                return PartitionSet();
+            }
+            involved_partitions_ids.insert(it->second);
+        }
+        return involved_partitions_ids;
+    }
+
+    // folds the keys of retired partitions into the remaining ones
+    void resize(int n_partitions) {
+        n_partitions_ = n_partitions;
+        round_robin_counter_ %= n_partitions_;
+        for (auto& kv : data_to_partition_id_) {
+            kv.second %= n_partitions_;
+        }
+    }
+
+    // deals every key round robin again, in key order
+    void round_robin_keys() {
+        std::vector<T> keys;
+        for (const auto& kv : data_to_partition_id_) {
+            keys.push_back(kv.first);
+        }
+        std::sort(keys.begin(), keys.end());
+        for (auto i = 0; i < keys.size(); i++) {
+            data_to_partition_id_[keys[i]] = i % n_partitions_;
+        }
+        round_robin_counter_ = keys.size() % n_partitions_;
+    }
+
+    /*
+        Replaces the mapping with a cut giving partition_scheme[i] to
+        sorted_keys[i], as cut_graph returns it, and returns how many keys
+        that were mapped changed partition.
+    */
+    int64_t assign(const std::vector<T>& sorted_keys,
+        const std::vector<int>& partition_scheme)
+    {
+        auto old_data_to_partition_id = std::move(data_to_partition_id_);
+        data_to_partition_id_ = std::unordered_map<T, int>();
+        int64_t keys_moved = 0;
+        for (auto i = 0; i < partition_scheme.size(); i++) {
+            auto partition_id = partition_scheme[i];
+            if (partition_id >= n_partitions_) {
+                printf("ERROR: partition was %d!\n", partition_id);
+                fflush(stdout);
+            }
+
+            auto data = sorted_keys[i];
+            data_to_partition_id_.emplace(data, partition_id);
+            auto old_partition = old_data_to_partition_id.find(data);
+            if (old_partition != old_data_to_partition_id.end() and
+                old_partition->second != partition_id)
+            {
+                keys_moved++;
+            }
+        }
+        if (method_ == model::RANGE) {
+            key_ranges_.assign(sorted_keys, partition_scheme, n_partitions_);
+            mapped_intervals_.clear();
+            for (auto i = 0; i < partition_scheme.size(); i++) {
+                add_mapped_interval(sorted_keys[i]);
+            }
+        }
+        return keys_moved;
+    }
+
+    // number of keys mapped to a different partition in previous
+    int64_t n_keys_moved_from(const KeyMapping<T>& previous) const {
+        int64_t keys_moved = 0;
+        for (const auto& kv : data_to_partition_id_) {
+            auto old_partition = previous.data_to_partition_id_.find(kv.first);
+            if (old_partition != previous.data_to_partition_id_.end() and
+                old_partition->second != kv.second)
+            {
+                keys_moved++;
+            }
+        }
+        return keys_moved;
+    }
+
+private:
+    // whether every key in [first, last] is mapped, with RANGE
+    bool all_mapped(T first, T last) const {
+        auto interval = mapped_intervals_.upper_bound(first);
+        if (interval == mapped_intervals_.begin()) {
+            return false;
+        }
+        return std::prev(interval)->second >= last;
+    }
+
+    void add_mapped_interval(T key) {
+        auto next = mapped_intervals_.upper_bound(key);
+        auto joins_next = next != mapped_intervals_.end() and
+            next->first == key + 1;
+        if (next != mapped_intervals_.begin()) {
+            auto previous = std::prev(next);
+            if (previous->second >= key) {
+                return;
+            }
+            if (previous->second == key - 1) {
+                previous->second = joins_next ? next->second : key;
+                if (joins_next) {
+                    mapped_intervals_.erase(next);
+                }
+                return;
+            }
+        }
+        auto last = joins_next ? next->second : key;
+        if (joins_next) {
+            mapped_intervals_.erase(next);
+        }
+        mapped_intervals_.emplace(key, last);
+    }
+
+    int n_partitions_;
+    model::CutMethod method_;
+    std::unordered_map<T, int> data_to_partition_id_;
+    KeyRanges<T> key_ranges_;  // the mapping as ranges, with RANGE
+    // first to last key of every run of consecutive mapped keys, with RANGE
+    std::map<T, T> mapped_intervals_;
+    int round_robin_counter_ = 0;
+};
+
+}
+
+#endif
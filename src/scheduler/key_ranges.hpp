@@ -0,0 +1,76 @@
+#ifndef KVPAXOS_KEY_RANGES_H
+#define KVPAXOS_KEY_RANGES_H
+
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "partition_set.h"
+
+
+namespace kvpaxos {
+
+/*
+    Contiguous key ranges owned by each partition, used by the RANGE cut
+    method. Partition i owns the keys from starts_[i] up to the next start,
+    so finding the partitions of a key or of a whole scan is a binary search
+    over the partitions instead of a lookup per key.
+*/
+template <typename T>
+class KeyRanges {
+public:
+    KeyRanges() : starts_{std::numeric_limits<T>::lowest()} {}
+
+    // splits [first, last) into n_partitions ranges of the same size
+    void split_evenly(T first, T last, int n_partitions) {
+        starts_.assign(1, std::numeric_limits<T>::lowest());
+        auto n_keys = last - first;
+        for (auto i = 1; i < n_partitions; i++) {
+            starts_.push_back(first + n_keys * i / n_partitions);
+        }
+    }
+
+    /*
+        Takes the ranges from a cut of sorted_keys whose partition ids never
+        decrease, as the RANGE cut method gives. Partitions left without
+        keys own an empty range.
+    */
+    void assign(const std::vector<T>& sorted_keys,
+        const std::vector<int>& partition_scheme, int n_partitions)
+    {
+        starts_.assign(n_partitions, std::numeric_limits<T>::max());
+        starts_[0] = std::numeric_limits<T>::lowest();
+        for (auto i = partition_scheme.size(); i > 0; i--) {
+            auto partition_id = partition_scheme[i-1];
+            if (partition_id > 0) {
+                starts_[partition_id] = sorted_keys[i-1];
+            }
+        }
+        for (auto i = n_partitions - 2; i > 0; i--) {
+            starts_[i] = std::min(starts_[i], starts_[i+1]);
+        }
+    }
+
+    int partition(T key) const {
+        auto next = std::upper_bound(starts_.begin(), starts_.end(), key);
+        return std::distance(starts_.begin(), next) - 1;
+    }
+
+    // partitions owning any key in [first, last]
+    PartitionSet partitions(T first, T last) const {
+        PartitionSet partitions_ids;
+        auto last_partition = partition(last);
+        for (auto i = partition(first); i <= last_partition; i++) {
+            partitions_ids.insert(i);
+        }
+        return partitions_ids;
+    }
+
+private:
+    std::vector<T> starts_;
+};
+
+}
+
+#endif
@@ -0,0 +1,91 @@
+#include "message_pool.h"
+
+#include <mutex>
+
+
+namespace kvpaxos {
+
+namespace {
+
+const std::size_t SLAB_SIZE = 256;
+const std::size_t CACHE_SIZE = 64;  // half is handed back past this
+
+struct free_list {
+    pooled_message* head{nullptr};
+    std::size_t size{0};
+
+    void push(pooled_message* message) {
+        message->next = head;
+        head = message;
+        size++;
+    }
+
+    pooled_message* pop() {
+        auto* message = head;
+        head = message->next;
+        size--;
+        return message;
+    }
+
+    void move_to(free_list& other, std::size_t n_messages) {
+        for (auto i = 0; i < n_messages and size > 0; i++) {
+            other.push(pop());
+        }
+    }
+};
+
+// never destroyed, thread caches may be given back after exit starts
+std::mutex& shared_mutex() {
+    static auto* mutex = new std::mutex();
+    return *mutex;
+}
+
+free_list& shared_list() {
+    static auto* list = new free_list();
+    return *list;
+}
+
+struct thread_cache : free_list {
+    ~thread_cache() {
+        std::lock_guard<std::mutex> lock(shared_mutex());
+        move_to(shared_list(), size);
+    }
+};
+
+thread_local thread_cache cache;
+
+}
+
+MessageRef MessagePool::acquire() {
+    if (cache.size == 0) {
+        std::lock_guard<std::mutex> lock(shared_mutex());
+        shared_list().move_to(cache, CACHE_SIZE / 2);
+    }
+    if (cache.size == 0) {
+        auto* slab = new pooled_message[SLAB_SIZE];
+        for (auto i = 0; i < SLAB_SIZE; i++) {
+            cache.push(&slab[i]);
+        }
+        n_allocated_ += SLAB_SIZE;
+    }
+
+    auto* message = cache.pop();
+    message->references.store(1, std::memory_order_relaxed);
+    return MessageRef(message);
+}
+
+MessageRef MessagePool::acquire(const struct command& command) {
+    auto message = acquire();
+    *message = command;
+    return message;
+}
+
+void MessagePool::release(pooled_message* message) {
+    cache.push(message);
+    if (cache.size > CACHE_SIZE) {
+        std::lock_guard<std::mutex> lock(shared_mutex());
+        cache.move_to(shared_list(), CACHE_SIZE / 2);
+    }
+}
+
+}
@@ -0,0 +1,86 @@
+#ifndef KVPAXOS_MESSAGE_POOL_H
+#define KVPAXOS_MESSAGE_POOL_H
+
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+#include "types/types.h"
+
+
+namespace kvpaxos {
+
+struct pooled_message {
+    struct command command;
+    std::atomic<int> references{0};
+    pooled_message* next{nullptr};  // while in a free list
+};
+
+/*
+    Counted reference to a pooled command, so a request is decoded once and
+    then shared by the tracker and the partitions instead of being copied
+    into each of their queues. The command goes back to the pool when the
+    last reference is dropped.
+*/
+class MessageRef {
+public:
+    MessageRef() = default;
+    // adopts a message whose count was already set for this reference
+    explicit MessageRef(pooled_message* message) : message_{message} {}
+
+    MessageRef(const MessageRef& other) : message_{other.message_} {
+        if (message_ != nullptr) {
+            message_->references.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    MessageRef(MessageRef&& other) noexcept : message_{other.message_} {
+        other.message_ = nullptr;
+    }
+    MessageRef& operator=(MessageRef other) noexcept {
+        std::swap(message_, other.message_);
+        return *this;
+    }
+    ~MessageRef() {reset();}
+
+    void reset();
+
+    struct command& operator*() const {return message_->command;}
+    struct command* operator->() const {return &message_->command;}
+    explicit operator bool() const {return message_ != nullptr;}
+
+private:
+    pooled_message* message_{nullptr};
+};
+
+/*
+    Process wide pool of commands. Each thread keeps a small cache of free
+    messages and trades them with a shared list in batches, so the
+    dispatcher taking messages and the partitions returning them rarely
+    meet on a lock. Messages are allocated in slabs and never freed.
+*/
+class MessagePool {
+public:
+    // a message holding a copy of command, or uninitialized without one
+    static MessageRef acquire();
+    static MessageRef acquire(const struct command& command);
+    static void release(pooled_message* message);
+
+    static std::size_t n_allocated() {return n_allocated_;}
+
+private:
+    static inline std::atomic<std::size_t> n_allocated_{0};
+};
+
+inline void MessageRef::reset() {
+    if (message_ != nullptr and
+        message_->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        MessagePool::release(message_);
+    }
+    message_ = nullptr;
+}
+
+}
+
+#endif
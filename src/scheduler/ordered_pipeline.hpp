@@ -0,0 +1,132 @@
+#ifndef KVPAXOS_ORDERED_PIPELINE_H
+#define KVPAXOS_ORDERED_PIPELINE_H
+
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace kvpaxos {
+
+/*
+    Runs the expensive, order-independent part of handling a stream of
+    items on several worker threads while a single sequencer handles them
+    one by one in the order they were fetched. Workers fetch items in turn,
+    so fetch() is never called concurrently, and then prepare() them in
+    parallel. At most window items are fetched ahead of the sequencer.
+*/
+template <typename Item>
+class OrderedPipeline {
+public:
+    OrderedPipeline(std::size_t window,
+        std::function<bool(Item&)> fetch,
+        std::function<void(Item&)> prepare,
+        std::function<void(Item&)> sequence)
+        : slots_(std::max<std::size_t>(window, 1)),
+          fetch_{fetch},
+          prepare_{prepare},
+          sequence_{sequence}
+    {}
+
+    /*
+        Returns once fetch() fails and every item fetched was sequenced.
+        on_started runs in the calling thread once the workers started, so
+        pinning it there isn't inherited by them.
+    */
+    void run(int n_workers, std::function<void()> on_started = nullptr) {
+        std::vector<std::thread> workers;
+        for (auto i = 0; i < std::max(n_workers, 1); i++) {
+            workers.emplace_back(&OrderedPipeline<Item>::worker_loop, this);
+        }
+        if (on_started) {
+            on_started();
+        }
+        sequencer_loop();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+private:
+    struct slot {
+        Item item;
+        bool ready = false;
+    };
+
+    void worker_loop() {
+        while (true) {
+            std::unique_lock<std::mutex> fetch_lock(fetch_mutex_);
+            auto sequence_number = next_fetch_;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                slot_free_.wait(lock, [this, sequence_number] {
+                    return sequence_number < next_sequence_ + slots_.size();
+                });
+            }
+
+            auto& slot = slots_[sequence_number % slots_.size()];
+            if (not fetch_(slot.item)) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    end_ = sequence_number;
+                }
+                slot_ready_.notify_all();
+                return;
+            }
+            next_fetch_++;
+            fetch_lock.unlock();
+
+            prepare_(slot.item);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                slot.ready = true;
+            }
+            slot_ready_.notify_all();
+        }
+    }
+
+    void sequencer_loop() {
+        while (true) {
+            auto& slot = slots_[next_sequence_ % slots_.size()];
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                slot_ready_.wait(lock, [this, &slot] {
+                    return slot.ready or next_sequence_ == end_;
+                });
+                if (not slot.ready) {
+                    return;
+                }
+            }
+
+            sequence_(slot.item);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                slot.ready = false;
+                next_sequence_++;
+            }
+            slot_free_.notify_all();
+        }
+    }
+
+    std::vector<slot> slots_;
+    std::function<bool(Item&)> fetch_;
+    std::function<void(Item&)> prepare_;
+    std::function<void(Item&)> sequence_;
+
+    std::mutex fetch_mutex_;  // keeps fetches in order
+    std::size_t next_fetch_{0};
+
+    std::mutex mutex_;
+    std::condition_variable slot_free_, slot_ready_;
+    std::size_t next_sequence_{0};
+    std::size_t end_{std::numeric_limits<std::size_t>::max()};
+};
+
+}
+
+#endif
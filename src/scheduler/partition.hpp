@@ -3,14 +3,15 @@
 
 
 #include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
 #include <evpaxos.h>
 #include <pthread.h>
 #include <queue>
-#include <iterator>
 #include <mutex>
 #include <numeric>
 #include <semaphore.h>
-#include <sstream>
 #include <shared_mutex>
 #include <string>
 #include <string.h>
@@ -19,16 +20,56 @@
 #include <unistd.h>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "constants/constants.h"
 #include "graph/graph.hpp"
+#include "metrics/replica_metrics.h"
+#include "metrics/stage_tracer.h"
 #include "request/request.hpp"
+#include "scheduler/message_pool.h"
+#include "scheduler/spin_wait.h"
 #include "storage/storage.h"
 #include "types/types.h"
 
 
 namespace kvpaxos {
 
+template <typename T>
+class Partition;
+
+/*
+    Point in the queues of every partition taking part in a multi-partition
+    request, or in a sync of all partitions, carried by SYNC messages in
+    s_addr. A partition that arrived at it holds back later requests on keys
+    from first_key to last_key until it is done and keeps running the rest.
+    The request runs on executor once every partition arrived and marks the
+    point done; without a request the last partition to arrive does. Each
+    partition drops its reference once it saw the point done, the one that
+    marks it done only after waking the others.
+*/
+template <typename T>
+struct sync_point {
+    T first_key, last_key;
+    const struct command* request{nullptr};
+    Partition<T>* executor{nullptr};
+    std::vector<Partition<T>*> partitions;
+    int id{0};
+    unsigned short sin_port{0};
+
+    std::atomic<int> n_arrived{0};
+    std::atomic<bool> done{false};
+    std::atomic<int> references{0};
+};
+
+template <typename T>
+void release_sync_point(sync_point<T>* point) {
+    if (point->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete point;
+    }
+}
+
 template <typename T>
 class Partition {
 public:
@@ -45,6 +86,7 @@ public:
             sem_post(&semaphore_);
             worker_thread_.join();
         }
+        close(socket_fd_);
     }
 
     static void populate_n_initial_keys(int n_keys) {
@@ -54,15 +96,23 @@ public:
         }
     }
 
-    void start_worker_thread() {
+    void start_worker_thread(int core = -1, int spin_budget = 0) {
+        spin_budget_ = spin_budget;
         sem_init(&semaphore_, 0, 0);
         worker_thread_ = std::thread(&Partition<T>::thread_loop, this);
+        pin_to_core(worker_thread_, core);
     }
 
-    void push_request(const struct client_message& request) {
+    void push_request(const MessageRef& request) {
         queue_mutex_.lock();
             requests_queue_.push(request);
         queue_mutex_.unlock();
+        queue_depth_.fetch_add(1, std::memory_order_relaxed);
+        sem_post(&semaphore_);
+    }
+
+    // makes the worker look again at the requests it holds back
+    void wake() {
         sem_post(&semaphore_);
     }
 
@@ -86,6 +136,34 @@ public:
         return n_executed_requests_;
     }
 
+    // empties the storage partitions share, once no partition is left
+    static void reset_shared_state() {
+        storage_.clear();
+        std::lock_guard<std::mutex> lk(executed_requests_mutex_);
+        n_executed_requests_ = 0;
+    }
+
+    const kvstorage::ValueCache& value_cache() const {
+        return value_cache_;
+    }
+
+    static std::size_t storage_memory_usage() {
+        return storage_.memory_usage();
+    }
+
+    metrics::partition_sample sample_metrics() const {
+        metrics::partition_sample sample;
+        sample.id = id_;
+        sample.queue_depth = queue_depth_.load(std::memory_order_relaxed);
+        sample.n_executed_requests = n_executed_.load(
+            std::memory_order_relaxed
+        );
+        sample.sync_wait_ns = sync_wait_ns_.load(std::memory_order_relaxed);
+        sample.cache_hits = value_cache_.hits();
+        sample.cache_misses = value_cache_.misses();
+        return sample;
+    }
+
 private:
 
     struct sockaddr_in get_client_addr(unsigned long ip, unsigned short port)
@@ -98,7 +176,7 @@ private:
     }
 
     void answer_client(const char* answer, size_t length,
-        client_message& message)
+        const struct command& message)
     {
         auto client_addr = get_client_addr(message.s_addr, message.sin_port);
 	auto bytes_written = sendto(
@@ -110,94 +188,273 @@ private:
         }
     }
 
+    /*
+        The semaphore is posted once for every queued message and once for
+        every wake(), so a wakeup finds the queue empty and only retries
+        the requests held back.
+    */
     void thread_loop() {
         while (executing_) {
-            sem_wait(&semaphore_);
+            auto wait_start = std::chrono::steady_clock::now();
+            spin_then_wait(&semaphore_, spin_budget_);
             if (not executing_) {
                 return;
             }
+            if (not held_.empty()) {
+                sync_wait_ns_.fetch_add(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - wait_start
+                    ).count(),
+                    std::memory_order_relaxed
+                );
+            }
 
+            MessageRef message;
             queue_mutex_.lock();
-                auto request = requests_queue_.front();
-                requests_queue_.pop();
+                if (not requests_queue_.empty()) {
+                    message = std::move(requests_queue_.front());
+                    requests_queue_.pop();
+                }
             queue_mutex_.unlock();
 
-            auto type = static_cast<request_type>(request.type);
-            auto key = request.key;
-            auto request_args = std::string(request.args);
+            if (not held_.empty() or not pending_syncs_.empty()) {
+                run_held_requests();
+            }
+            if (not message) {
+                continue;
+            }
 
-            std::string answer;
-            switch (type)
-            {
-            case READ:
-            {
-                answer = storage_.read(key);
-                break;
+            queue_depth_.fetch_sub(1, std::memory_order_relaxed);
+            if (can_run(*message, held_.size())) {
+                run(*message);
+            } else {
+                held_.push_back(std::move(message));
             }
+        }
+    }
 
-            case WRITE:
-            {
-                storage_.write(key, request_args);
-                answer = request_args;
-                break;
+    void run_held_requests() {
+        auto progress = true;
+        while (progress) {
+            progress = false;
+            drop_finished_syncs();
+            for (auto i = 0; i < held_.size();) {
+                if (not can_run(*held_[i], i)) {
+                    i++;
+                    continue;
+                }
+                auto message = std::move(held_[i]);
+                held_.erase(held_.begin() + i);
+                run(*message);
+                progress = true;
             }
+        }
+    }
 
-            case SCAN:
-            {
-                auto length = std::stoi(request_args);
-                auto values = storage_.scan(key, length);
+    std::pair<T, T> keys(const struct command& request) const {
+        if (request.type == SYNC) {
+            auto* point = (sync_point<T>*) request.s_addr;
+            return std::make_pair(point->first_key, point->last_key);
+        }
+        auto length = request.type == SCAN ? std::max(request.scan_length, 1) : 1;
+        return std::make_pair(T(request.key), T(request.key + length - 1));
+    }
 
+    static bool overlap(const std::pair<T, T>& a, const std::pair<T, T>& b) {
+        return a.first <= b.second and b.first <= a.second;
+    }
 
-                std::ostringstream oss;
-                std::copy(values.begin(), values.end(), std::ostream_iterator<std::string>(oss, ","));
-                answer = std::string(oss.str());
-                break;
+    /*
+        A request runs unless it shares keys with a sync point this
+        partition arrived at and that isn't done, or with a request held
+        before it, which keeps requests on the same key in order. The
+        request of a sync point runs once everyone arrived.
+    */
+    bool can_run(const struct command& request, std::size_t n_held_before) {
+        if (request.type == ERROR) {
+            return true;
+        }
+        auto request_keys = keys(request);
+        for (auto* point : pending_syncs_) {
+            if (point->done or
+                not overlap(
+                    request_keys,
+                    std::make_pair(point->first_key, point->last_key)
+                ))
+            {
+                continue;
             }
-
-            case SYNC:
+            if (point->request == &request and
+                point->n_arrived == point->partitions.size())
             {
-                auto barrier = (pthread_barrier_t*) request.s_addr;
-                auto coordinator = pthread_barrier_wait(barrier);
-                if (coordinator) {
-                    pthread_barrier_destroy(barrier);
-                    delete barrier;
-                }
-                break;
+                continue;
             }
+            return false;
+        }
+        for (auto i = 0; i < n_held_before; i++) {
+            if (held_[i]->type != ERROR and
+                overlap(request_keys, keys(*held_[i])))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
 
-            case ERROR:
-                answer = "ERROR";
-                break;
-            default:
+    void run(const struct command& request) {
+        if (request.type == SYNC) {
+            return arrive((sync_point<T>*) request.s_addr);
+        }
+
+        // time held back by other requests counts as queued, and the
+        // wait for the partitions of its own sync point as synced
+        sync_point<T>* own_point = nullptr;
+        for (auto* point : pending_syncs_) {
+            if (point->request == &request and not point->done) {
+                own_point = point;
+                metrics::StageTracer::record(
+                    metrics::SYNC_EXITED, request.id, request.sin_port
+                );
                 break;
             }
+        }
+        metrics::StageTracer::record(
+            metrics::DEQUEUED, request.id, request.sin_port
+        );
+        execute(request);
+        if (own_point != nullptr) {
+            finish(own_point);
+        }
+    }
+
+    void arrive(sync_point<T>* point) {
+        // syncs of repartitions and resizes belong to no request
+        if (point->request != nullptr) {
+            metrics::StageTracer::record(
+                metrics::SYNC_ENTERED, point->id, point->sin_port
+            );
+        }
+        pending_syncs_.push_back(point);
+        auto n_arrived = point->n_arrived.fetch_add(1) + 1;
+        if (n_arrived < point->partitions.size()) {
+            return;
+        }
+        if (point->request == nullptr) {
+            finish(point);
+        } else {
+            point->executor->wake();
+        }
+    }
+
+    void finish(sync_point<T>* point) {
+        point->done = true;
+        for (auto* partition : point->partitions) {
+            if (partition != this) {
+                partition->wake();
+            }
+        }
+        drop_finished_syncs();
+    }
 
-            if (type == SYNC) {
+    void drop_finished_syncs() {
+        for (auto i = 0; i < pending_syncs_.size();) {
+            auto* point = pending_syncs_[i];
+            if (not point->done) {
+                i++;
                 continue;
             }
+            pending_syncs_[i] = pending_syncs_.back();
+            pending_syncs_.pop_back();
+            release_sync_point(point);
+        }
+    }
+
+    void execute(const struct command& request) {
+        auto type = static_cast<request_type>(request.type);
+        auto key = request.key;
+
+        // values are decoded straight into the reply, leaving
+        // the last byte of the answer for the null terminator
+        reply_message reply;
+        auto capacity = sizeof(reply.answer) - 1;
+        std::size_t answer_size = 0;
+        switch (type)
+        {
+        case READ:
+        {
+            answer_size = storage_.read(
+                key, reply.answer, capacity, value_cache_
+            );
+            break;
+        }
 
-            reply_message reply;
-            reply.id = request.id;
-            strncpy(reply.answer, answer.c_str(), answer.size());
-            reply.answer[answer.size()] = '\0';
+        case WRITE:
+        {
+            storage_.write(
+                key, request.value, request.value_size, value_cache_
+            );
+            answer_size = std::min<std::size_t>(
+                request.value_size, capacity
+            );
+            memcpy(reply.answer, request.value, answer_size);
+            break;
+        }
 
-            answer_client((char *)&reply, sizeof(reply_message), request);
+        case SCAN:
+        {
+            answer_size = storage_.scan(
+                key, request.scan_length, reply.answer, capacity,
+                value_cache_
+            );
+            break;
+        }
 
-            std::lock_guard<std::mutex> lk(executed_requests_mutex_);
-            n_executed_requests_++;
+        case ERROR:
+            answer_size = strlen("ERROR");
+            memcpy(reply.answer, "ERROR", answer_size);
+            break;
+        default:
+            break;
         }
+
+        metrics::StageTracer::record(
+            metrics::EXECUTED, request.id, request.sin_port
+        );
+
+        reply.id = request.id;
+        reply.type = type;
+        reply.size = answer_size;
+        reply.answer[answer_size] = '\0';
+
+        answer_client((char *)&reply, reply_message_size(reply), request);
+        metrics::StageTracer::record(
+            metrics::ANSWERED, request.id, request.sin_port
+        );
+        n_executed_.fetch_add(1, std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lk(executed_requests_mutex_);
+        n_executed_requests_++;
     }
 
     int id_, socket_fd_;
     static inline kvstorage::Storage storage_;
+    kvstorage::ValueCache value_cache_;
     static inline int n_executed_requests_;
     static inline std::mutex executed_requests_mutex_;
 
     bool executing_;
     std::thread worker_thread_;
     sem_t semaphore_;
-    std::queue<struct client_message> requests_queue_;
+    int spin_budget_{0};
+    std::queue<MessageRef> requests_queue_;
     std::mutex queue_mutex_;
+    // only touched by the worker
+    std::deque<MessageRef> held_;
+    std::vector<sync_point<T>*> pending_syncs_;
+
+    std::atomic<int> queue_depth_{0};
+    std::atomic<int64_t> n_executed_{0};
+    std::atomic<int64_t> sync_wait_ns_{0};
 
     std::unordered_set<T> data_set_;
 };
@@ -0,0 +1,81 @@
+#ifndef KVPAXOS_PARTITION_SET_H
+#define KVPAXOS_PARTITION_SET_H
+
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+
+namespace kvpaxos {
+
+/*
+    Set of partition ids kept in a single word, so building, copying and
+    iterating the partitions of a request never touches the heap. Ids are
+    iterated in increasing order.
+*/
+class PartitionSet {
+public:
+    static constexpr int MAX_PARTITIONS = 64;
+
+    class iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = int;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const int*;
+        using reference = int;
+
+        explicit iterator(uint64_t bits) : bits_{bits} {}
+
+        int operator*() const {return __builtin_ctzll(bits_);}
+        iterator& operator++() {
+            bits_ &= bits_ - 1;
+            return *this;
+        }
+        bool operator==(const iterator& other) const {
+            return bits_ == other.bits_;
+        }
+        bool operator!=(const iterator& other) const {
+            return bits_ != other.bits_;
+        }
+
+    private:
+        uint64_t bits_;
+    };
+
+    PartitionSet() = default;
+
+    // the set of partitions 0 to n_partitions-1
+    static PartitionSet first(int n_partitions) {
+        PartitionSet set;
+        if (n_partitions >= MAX_PARTITIONS) {
+            set.bits_ = ~uint64_t(0);
+        } else if (n_partitions > 0) {
+            set.bits_ = (uint64_t(1) << n_partitions) - 1;
+        }
+        return set;
+    }
+
+    void insert(int partition_id) {bits_ |= uint64_t(1) << partition_id;}
+    bool contains(int partition_id) const {
+        return bits_ & (uint64_t(1) << partition_id);
+    }
+    bool empty() const {return bits_ == 0;}
+    int size() const {return __builtin_popcountll(bits_);}
+    void clear() {bits_ = 0;}
+
+    iterator begin() const {return iterator(bits_);}
+    iterator end() const {return iterator(0);}
+
+    bool operator==(const PartitionSet& other) const {
+        return bits_ == other.bits_;
+    }
+
+private:
+    uint64_t bits_{0};
+};
+
+}
+
+#endif
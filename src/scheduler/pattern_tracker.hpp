@@ -2,6 +2,8 @@
 #define KVPAXOS_PATTERN_TRACKER_H
 
 
+#include <algorithm>
+#include <atomic>
 #include <evpaxos/paxos.h>
 #include <mutex>
 #include <queue>
@@ -11,6 +13,8 @@
 #include <unordered_set>
 
 #include "graph/graph.hpp"
+#include "message_pool.h"
+#include "partition_set.h"
 #include "types/types.h"
 
 
@@ -67,15 +71,20 @@ public:
         update_thread_ = std::thread(&PatternTracker<T>::thread_loop, this);
     }
 
-    void push_request(const client_message& request) {
+    void push_request(const MessageRef& request) {
         {
             std::scoped_lock lock(queue_mutex_);
             requests_queue_.push(request);
         }
+        backlog_.fetch_add(1, std::memory_order_relaxed);
         sem_post(&semaphore_);
     }
 
-    void register_access(const std::unordered_set<int>& partitions_ids) {
+    int backlog() const {
+        return backlog_.load(std::memory_order_relaxed);
+    }
+
+    void register_access(const PartitionSet& partitions_ids) {
         for (auto partition_id: partitions_ids) {
             accesses_per_partition_[partition_id] += 1;
         }
@@ -85,6 +94,19 @@ public:
         accesses_per_partition_[partition_id] += number_of_accesses;
     }
 
+    // accesses of retired partitions are folded into the remaining ones the
+    // same way the scheduler folds their keys before cutting the graph
+    void resize_partitions(int n_partitions) {
+        std::unordered_map<int, int> accesses_per_partition;
+        for (auto i = 0; i < n_partitions; i++) {
+            accesses_per_partition[i] = 0;
+        }
+        for (const auto& kv: accesses_per_partition_) {
+            accesses_per_partition[kv.first % n_partitions] += kv.second;
+        }
+        accesses_per_partition_ = std::move(accesses_per_partition);
+    }
+
     void reset_accesses() {
         for (const auto& kv: accesses_per_partition_) {
             auto partition_id = kv.first;
@@ -92,6 +114,24 @@ public:
         }
     }
 
+    // exposed so that benchmarks can measure it without the update thread
+    void update_workload_graph(const struct command& request) {
+        auto length = 1;
+        if (request.type == SCAN) {
+            length = std::max(request.scan_length, 1);
+        }
+
+        for (auto i = 0; i < length; i++) {
+            auto data = request.key + i;
+            if (not workload_graph_.vertice_exists(data)) {
+                workload_graph_.add_vertice(data);
+            }
+            workload_graph_.increase_vertice_weight(data);
+        }
+        // a scan is one range rather than an edge between each pair of keys
+        workload_graph_.add_range(request.key, length);
+    }
+
 private:
     void thread_loop() {
         while(executing_) {
@@ -101,9 +141,11 @@ private:
             }
 
             queue_mutex_.lock();
-                auto request = requests_queue_.front();
+                auto message = std::move(requests_queue_.front());
                 requests_queue_.pop();
             queue_mutex_.unlock();
+            const auto& request = *message;
+            backlog_.fetch_sub(1, std::memory_order_relaxed);
 
             auto type = static_cast<request_type>(request.type);
             switch (type) {
@@ -123,46 +165,15 @@ private:
         }
     }
 
-    void update_workload_graph(const client_message& request) {
-        std::vector<int> data{request.key};
-        if (request.type == SCAN) {
-            for (auto i = 1; i < std::stoi(request.args); i++) {
-                data.emplace_back(request.key+i);
-            }
-        }
-
-        for (auto i = 0; i < data.size(); i++) {
-            if (not workload_graph_.vertice_exists(data[i])) {
-                workload_graph_.add_vertice(data[i]);
-            }
-
-            workload_graph_.increase_vertice_weight(data[i]);
-            for (auto j = i+1; j < data.size(); j++) {
-                if (not workload_graph_.vertice_exists(data[j])) {
-                    workload_graph_.add_vertice(data[j]);
-                }
-                if (not workload_graph_.are_connected(data[i], data[j])) {
-                    workload_graph_.add_edge(data[i], data[j]);
-                }
-                if (not workload_graph_.are_connected(data[j], data[i])) {
-                    workload_graph_.add_edge(data[j], data[i]);
-                }
-
-                workload_graph_.increase_edge_weight(data[i], data[j]);
-                workload_graph_.increase_edge_weight(data[j], data[i]);
-            }
-        }
-
-    }
-
     model::Graph<T> workload_graph_;
     std::unordered_map<int, int> accesses_per_partition_;
 
     bool executing_;
     std::thread update_thread_;
-    std::queue<struct client_message> requests_queue_;
+    std::queue<MessageRef> requests_queue_;
     sem_t semaphore_;
     std::mutex queue_mutex_;
+    std::atomic<int> backlog_{0};
 };
 
 }
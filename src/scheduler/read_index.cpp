@@ -0,0 +1,72 @@
+#include "read_index.h"
+
+#include <string.h>
+
+
+namespace kvpaxos {
+
+ReadIndex::ReadIndex(int holder_id, int replica_id,
+    std::chrono::microseconds retry_timeout)
+    : holder_id_{holder_id},
+      replica_id_{replica_id},
+      retry_timeout_{retry_timeout}
+{}
+
+void ReadIndex::add_read(const char* value, std::size_t size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    waiting_reads_.emplace_back(value, size);
+}
+
+bool ReadIndex::next_marker(struct command& marker) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto now = std::chrono::steady_clock::now();
+    if (marker_pending_) {
+        if (now - pending_since_ < retry_timeout_) {
+            return false;
+        }
+    } else if (waiting_reads_.empty()) {
+        return false;
+    }
+
+    // a retry covers the reads of the lost marker too, since it is
+    // proposed after all of them arrived
+    for (auto& read : waiting_reads_) {
+        covered_reads_.push_back(std::move(read));
+    }
+    waiting_reads_.clear();
+    marker_pending_ = true;
+    pending_marker_id_ = n_markers_++;
+    pending_since_ = now;
+
+    memset(&marker, 0, sizeof(marker));
+    marker.type = READ_INDEX;
+    marker.key = replica_id_;
+    marker.id = pending_marker_id_;
+    return true;
+}
+
+void ReadIndex::delivered(const struct command& marker,
+    std::vector<std::string>& reads)
+{
+    if (not holder() or marker.key != replica_id_) {
+        return;
+    }
+
+    bool reads_waiting;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // markers that were retried cover nothing of their own anymore
+        if (not marker_pending_ or marker.id != pending_marker_id_) {
+            return;
+        }
+        reads.swap(covered_reads_);
+        covered_reads_.clear();
+        marker_pending_ = false;
+        reads_waiting = not waiting_reads_.empty();
+    }
+    if (reads_waiting and reads_waiting_) {
+        reads_waiting_();
+    }
+}
+
+}
@@ -0,0 +1,71 @@
+#ifndef KVPAXOS_READ_INDEX_H
+#define KVPAXOS_READ_INDEX_H
+
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "types/types.h"
+
+
+namespace kvpaxos {
+
+/*
+    Lets one replica answer reads without ordering each of them through
+    Paxos while staying linearizable. For reads it received, the holder
+    submits a READ_INDEX marker through Paxos and answers them once the
+    marker is delivered, right after it in log order. Any write completed
+    before a read arrived was decided before the marker was proposed, so
+    it is delivered, and the read sees it. Reads arriving while a marker
+    is pending wait for the next one, so a single marker covers every read
+    received in the meantime.
+*/
+class ReadIndex {
+public:
+    ReadIndex(int holder_id, int replica_id,
+        std::chrono::microseconds retry_timeout);
+
+    bool holder() const {return holder_id_ == replica_id_;}
+    /*
+        Called by delivered(), outside the lock, when reads are left waiting
+        for the next marker, so it can be submitted right away.
+    */
+    void set_reads_waiting_callback(std::function<void()> callback) {
+        reads_waiting_ = std::move(callback);
+    }
+
+    // queues an encoded read received by the holder
+    void add_read(const char* value, std::size_t size);
+    /*
+        Whether a marker must be submitted for reads that no pending
+        marker covers, or because the pending one was proposed more than
+        retry_timeout ago and may have been lost. If so, marker is the
+        command to submit, and it covers every queued read.
+    */
+    bool next_marker(struct command& marker);
+    // called in log order, swaps the reads the marker covers into reads
+    void delivered(const struct command& marker,
+        std::vector<std::string>& reads);
+
+private:
+    typedef std::chrono::steady_clock::time_point time_point;
+
+    int holder_id_, replica_id_;
+    std::chrono::microseconds retry_timeout_;
+    std::function<void()> reads_waiting_;
+
+    std::mutex mutex_;
+    std::vector<std::string> waiting_reads_;  // not covered by a marker
+    std::vector<std::string> covered_reads_;  // by the pending marker
+    bool marker_pending_{false};
+    int pending_marker_id_{0};
+    time_point pending_since_;
+    int n_markers_{0};
+};
+
+}
+
+#endif
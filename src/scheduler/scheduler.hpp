@@ -2,13 +2,19 @@
 #define _KVPAXOS_SCHEDULER_H_
 
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstdint>
+#include <limits>
 #include <memory>
 #include <netinet/tcp.h>
 #include <pthread.h>
 #include <queue>
 #include <semaphore.h>
 #include <shared_mutex>
+#include <stdexcept>
 #include <string>
 #include <string.h>
 #include <thread>
@@ -16,7 +22,12 @@
 #include <vector>
 
 #include "graph/partitioning.h"
+#include "metrics/replica_metrics.h"
+#include "metrics/stage_tracer.h"
+#include "key_mapping.hpp"
+#include "message_pool.h"
 #include "partition.hpp"
+#include "partition_set.h"
 #include "pattern_tracker.hpp"
 #include "request/request.hpp"
 #include "storage/storage.h"
@@ -25,6 +36,16 @@
 
 namespace kvpaxos {
 
+/*
+    Partitions a request was mapped to ahead of being scheduled. It is
+    still valid when scheduled if the mapping epoch didn't change, since
+    keys are only ever added to the mapping in between.
+*/
+struct dispatch_plan {
+    PartitionSet partitions_ids;
+    uint64_t mapping_epoch = 0;
+};
+
 template <typename T>
 class Scheduler {
 public:
@@ -36,8 +57,14 @@ public:
         repartition_interval_{repartition_interval},
         repartition_method_{repartition_method},
         pattern_tracker_{PatternTracker<T>(n_partitions)},
-        data_to_partition_id_{std::unordered_map<T, int>()}
+        key_mapping_{n_partitions, repartition_method}
     {
+        if (n_partitions < 1 or n_partitions > PartitionSet::MAX_PARTITIONS) {
+            throw std::invalid_argument(
+                "Number of partitions must be between 1 and " +
+                std::to_string(PartitionSet::MAX_PARTITIONS)
+            );
+        }
         for (auto i = 0; i < n_partitions_; i++) {
             partitions_.emplace(i, i);
         }
@@ -46,16 +73,43 @@ public:
     }
 
     void populate_n_initial_keys(int n_keys) {
+        {
+            std::unique_lock lock(mapping_mutex_);
+            key_mapping_.populate_n_initial_keys(n_keys);
+        }
         for (auto i = 0; i < n_keys; i++) {
-            add_key(i);
+            partitions_.at(key_mapping_.partition(i)).insert_data(i);
         }
         Partition<T>::populate_n_initial_keys(n_keys);
         pattern_tracker_.populate_n_sequential_vertices(n_keys);
     }
 
+    /*
+        Pins partition i to partition_cores[i % size] and has partitions
+        spin spin_budget times on an empty queue before sleeping. Must be
+        called before run(); partitions added by a resize follow it too.
+    */
+    void set_execution_mode(
+        const std::vector<int>& partition_cores, int spin_budget)
+    {
+        partition_cores_ = partition_cores;
+        spin_budget_ = spin_budget;
+    }
+
+    /*
+        With conflict-aware syncs, partitions waiting on a multi-partition
+        request only hold back requests on its keys and keep running the
+        rest. Otherwise they wait for it before running anything else.
+    */
+    void set_conflict_aware_sync(bool conflict_aware_sync) {
+        conflict_aware_sync_ = conflict_aware_sync;
+    }
+
     void run() {
         for (auto& kv : partitions_) {
-            kv.second.start_worker_thread();
+            kv.second.start_worker_thread(
+                partition_core(kv.first), spin_budget_
+            );
         }
         pattern_tracker_.run();
     }
@@ -64,46 +118,82 @@ public:
         return Partition<T>::n_executed_requests();
     }
 
-    void schedule_and_answer(struct client_message& request) {
+    // may be called from any thread while requests are scheduled
+    metrics::replica_sample sample_metrics() const {
+        metrics::replica_sample sample;
+        auto epoch = std::chrono::system_clock::now().time_since_epoch();
+        sample.epoch = epoch.count();
+        {
+            std::shared_lock lock(partitions_mutex_);
+            for (auto i = 0; i < partitions_.size(); i++) {
+                sample.partitions.push_back(partitions_.at(i).sample_metrics());
+            }
+        }
+        sample.n_scheduled_requests = n_scheduled_requests_;
+        sample.n_cross_partition_requests = n_cross_partition_requests_;
+        sample.tracker_backlog = pattern_tracker_.backlog();
+        sample.n_repartitions = n_repartitions_;
+        sample.last_repartition_duration_ns = last_repartition_duration_ns_;
+        sample.total_repartition_duration_ns = total_repartition_duration_ns_;
+        sample.last_keys_moved = last_keys_moved_;
+        sample.total_keys_moved = total_keys_moved_;
+        sample.storage_bytes = Partition<T>::storage_memory_usage();
+        sample.delivery_queue_depth = 0;
+        sample.n_delivery_stalls = 0;
+        return sample;
+    }
+
+    /*
+        Maps request to its partitions against the current mapping. Unlike
+        the rest of the scheduler it may be called from any thread, so
+        requests can be planned in parallel before being scheduled in order.
+    */
+    dispatch_plan plan(const struct command& request) const {
+        dispatch_plan plan;
+        std::shared_lock lock(mapping_mutex_);
+        plan.partitions_ids = key_mapping_.involved_partitions(request);
+        plan.mapping_epoch = mapping_epoch_;
+        return plan;
+    }
+
+    // the message is shared by the partition and tracker it is queued to
+    void schedule_and_answer(const MessageRef& message,
+        const dispatch_plan& plan = dispatch_plan())
+    {
+        auto& request = *message;
         auto type = static_cast<request_type>(request.type);
-        if (type == SYNC) {
+        if (type == SYNC or type == READ_INDEX) {
             return;
         }
+        if (type == RESIZE) {
+            return resize(request.key);
+        }
 
         if (type == WRITE) {
-            if (not mapped(request.key)) {
+            if (not key_mapping_.mapped(request.key)) {
                 add_key(request.key);
             }
         }
 
-        auto involved_partitions_ids = std::move(involved_partitions(request));
+        auto involved_partitions_ids = planned_partitions(request, plan);
         if (involved_partitions_ids.empty()) {
             request.type = ERROR;
-            return partitions_.at(0).push_request(request);
+            metrics::StageTracer::record(
+                metrics::DISPATCHED, request.id, request.sin_port
+            );
+            return partitions_.at(0).push_request(message);
         }
 
-        auto arbitrary_partition_id = *begin(involved_partitions_ids);
-        auto& arbitrary_partition = partitions_.at(arbitrary_partition_id);
-        if (involved_partitions_ids.size() > 1) {
-            sync_partitions(involved_partitions_ids);
-            arbitrary_partition.push_request(request);
-            sync_partitions(involved_partitions_ids);
-        } else {
-            arbitrary_partition.push_request(request);
-        }
+        dispatch(message, involved_partitions_ids);
 
         if (repartition_method_ != model::ROUND_ROBIN) {
-            pattern_tracker_.push_request(request);
+            pattern_tracker_.push_request(message);
             pattern_tracker_.register_access(involved_partitions_ids);
             n_dispatched_requests_++;
             if (
                 n_dispatched_requests_ % repartition_interval_ == 0
             ) {
-                struct client_message sync_message;
-                sync_message.type = SYNC;
-                sync_message.s_addr = (unsigned long) &repartition_barrier_;
-
-                pattern_tracker_.push_request(sync_message);
+                pattern_tracker_.push_request(create_tracker_sync_request());
                 pthread_barrier_wait(&repartition_barrier_);
                 repartition_data();
                 sync_all_partitions();
@@ -111,109 +201,290 @@ public:
         }
     }
 
-private:
-    std::unordered_set<int> involved_partitions(
-        const struct client_message& request)
+    /*
+        Schedules a READ or SCAN that wasn't ordered by Paxos, answered
+        only by the read index holder. It is executed in order with
+        everything scheduled before it, but is left out of the workload
+        graph and the repartition count, which must stay the same in every
+        replica.
+    */
+    void schedule_local_read(const MessageRef& message,
+        const dispatch_plan& plan = dispatch_plan())
     {
-        std::unordered_set<int> involved_partitions_ids;
+        auto& request = *message;
         auto type = static_cast<request_type>(request.type);
+        if (type != READ and type != SCAN) {
+            return;
+        }
+
+        auto involved_partitions_ids = planned_partitions(request, plan);
+        if (involved_partitions_ids.empty()) {
+            request.type = ERROR;
+            return partitions_.at(0).push_request(message);
+        }
+        dispatch(message, involved_partitions_ids);
+    }
 
-        auto range = 1;
-        if (type == SCAN) {
-            range = std::stoi(request.args);
+    /*
+        Changes the number of partitions. Called in log order, so every
+        replica resizes between the same requests. New partitions start
+        before the graph is cut again into the new count; retired ones run
+        until the sync that follows the cut and are then stopped. Keys of
+        retired partitions are folded into the remaining ones before the
+        cut, which is what the cut methods that refine the current mapping
+        start from.
+    */
+    void resize(int n_partitions) {
+        if (n_partitions < 1 or n_partitions == n_partitions_) {
+            return;
+        }
+        if (n_partitions > PartitionSet::MAX_PARTITIONS) {
+            printf(
+                "Ignoring resize to %d partitions, at most %d are supported\n",
+                n_partitions, PartitionSet::MAX_PARTITIONS
+            );
+            return;
         }
 
-        for (auto i = 0; i < range; i++) {
-            if (not mapped(request.key + i)) {
-                return std::unordered_set<int>();
+        auto old_n_partitions = n_partitions_;
+        {
+            std::unique_lock lock(partitions_mutex_);
+            for (auto i = old_n_partitions; i < n_partitions; i++) {
+                partitions_.emplace(i, i);
+                partitions_.at(i).start_worker_thread(
+                    partition_core(i), spin_budget_
+                );
             }
+        }
+        n_partitions_ = n_partitions;
+
+        auto old_key_mapping = key_mapping_;
+        {
+            std::unique_lock lock(mapping_mutex_);
+            key_mapping_.resize(n_partitions_);
+            mapping_epoch_++;
+        }
+        pattern_tracker_.resize_partitions(n_partitions_);
+
+        if (repartition_method_ == model::ROUND_ROBIN) {
+            round_robin_keys();
+        } else {
+            pattern_tracker_.push_request(create_tracker_sync_request());
+            pthread_barrier_wait(&repartition_barrier_);
+            repartition_data();
+        }
 
-            involved_partitions_ids.insert(data_to_partition_id_.at(request.key + i));
+        auto keys_moved = key_mapping_.n_keys_moved_from(old_key_mapping);
+        if (repartition_method_ == model::ROUND_ROBIN) {
+            total_keys_moved_ += keys_moved;
+        } else {
+            // repartition_data() already counted the keys its cut moved
+            total_keys_moved_ += keys_moved - last_keys_moved_;
         }
+        last_keys_moved_ = keys_moved;
 
-        return involved_partitions_ids;
+        // retired partitions are done once every partition dropped the
+        // sync, which they take part in with nothing queued after it
+        auto* point = sync_all_partitions(true);
+        while (point->references.load() > 1) {
+            std::this_thread::yield();
+        }
+        delete point;
+        {
+            std::unique_lock lock(partitions_mutex_);
+            for (auto i = n_partitions_; i < old_n_partitions; i++) {
+                partitions_.erase(i);
+            }
+        }
     }
 
-    struct client_message create_sync_request(int n_partitions) {
-        struct client_message sync_message;
-        sync_message.id = sync_counter_;
-        sync_message.type = SYNC;
+private:
+    void round_robin_keys() {
+        std::unique_lock lock(mapping_mutex_);
+        mapping_epoch_++;
+        key_mapping_.round_robin_keys();
+    }
 
-        // this is a gross workaround to send the barrier to the partitions.
-        // a more elegant approach would be appreciated.
-        auto* barrier = new pthread_barrier_t();
-        pthread_barrier_init(barrier, NULL, n_partitions);
-        sync_message.s_addr = (unsigned long) barrier;
+    void dispatch(const MessageRef& message,
+        const PartitionSet& involved_partitions_ids)
+    {
+        const auto& request = *message;
+        auto arbitrary_partition_id = *involved_partitions_ids.begin();
+        auto& arbitrary_partition = partitions_.at(arbitrary_partition_id);
+        n_scheduled_requests_.fetch_add(1, std::memory_order_relaxed);
+        if (involved_partitions_ids.size() > 1) {
+            n_cross_partition_requests_.fetch_add(
+                1, std::memory_order_relaxed
+            );
+            sync_partitions(involved_partitions_ids, &request);
+            metrics::StageTracer::record(
+                metrics::DISPATCHED, request.id, request.sin_port
+            );
+            arbitrary_partition.push_request(message);
+        } else {
+            metrics::StageTracer::record(
+                metrics::DISPATCHED, request.id, request.sin_port
+            );
+            arbitrary_partition.push_request(message);
+        }
+    }
 
-        return sync_message;
+    PartitionSet planned_partitions(
+        const struct command& request, const dispatch_plan& plan) const
+    {
+        if (plan.mapping_epoch == mapping_epoch_ and
+            not plan.partitions_ids.empty())
+        {
+            return plan.partitions_ids;
+        }
+        return key_mapping_.involved_partitions(request);
+    }
+
+    MessageRef create_tracker_sync_request() {
+        auto message = MessagePool::acquire();
+        message->type = SYNC;
+        message->s_addr = (unsigned long) &repartition_barrier_;
+        return message;
     }
 
-    void sync_partitions(const std::unordered_set<int>& partitions_ids) {
-        auto sync_message = create_sync_request(partitions_ids.size());
+    /*
+        One message is shared by every partition taking part in the sync. It
+        covers the keys of request when syncs are conflict-aware, and every
+        key otherwise or when there is no request. The request runs on the
+        first partition, as dispatch() queues it.
+    */
+    MessageRef create_sync_request(const PartitionSet& partitions_ids,
+        const struct command* request, int extra_references)
+    {
+        auto* point = new sync_point<T>();
+        point->first_key = std::numeric_limits<T>::lowest();
+        point->last_key = std::numeric_limits<T>::max();
+        if (request != nullptr) {
+            if (conflict_aware_sync_) {
+                auto length = 1;
+                if (request->type == SCAN) {
+                    length = std::max(request->scan_length, 1);
+                }
+                point->first_key = request->key;
+                point->last_key = request->key + length - 1;
+            }
+            point->request = request;
+            point->executor = &partitions_.at(*partitions_ids.begin());
+            // lets stage traces charge the wait to the request
+            point->id = request->id;
+            point->sin_port = request->sin_port;
+        }
+        for (auto partition_id : partitions_ids) {
+            point->partitions.push_back(&partitions_.at(partition_id));
+        }
+        point->references = point->partitions.size() + extra_references;
+
+        auto message = MessagePool::acquire();
+        message->id = point->id;
+        message->type = SYNC;
+        message->sin_port = point->sin_port;
+        message->s_addr = (unsigned long) point;
+        return message;
+    }
+
+    sync_point<T>* sync_partitions(const PartitionSet& partitions_ids,
+        const struct command* request = nullptr, bool hold = false)
+    {
+        auto sync_message = create_sync_request(
+            partitions_ids, request, hold ? 1 : 0
+        );
         for (auto partition_id : partitions_ids) {
             auto& partition = partitions_.at(partition_id);
             partition.push_request(sync_message);
         }
+        return (sync_point<T>*) sync_message->s_addr;
     }
 
-    void sync_all_partitions() {
-        std::unordered_set<int> partitions_ids;
-        for (auto i = 0; i < partitions_.size(); i++) {
-            partitions_ids.insert(i);
-        }
-        sync_partitions(partitions_ids);
+    // with hold, the sync point is kept for the caller to delete once
+    // only its reference is left
+    sync_point<T>* sync_all_partitions(bool hold = false) {
+        return sync_partitions(
+            PartitionSet::first(partitions_.size()), nullptr, hold
+        );
     }
 
     void add_key(T key) {
-        auto partition_id = round_robin_counter_;
+        int partition_id;
+        {
+            std::unique_lock lock(mapping_mutex_);
+            partition_id = key_mapping_.add_key(key);
+        }
         partitions_.at(partition_id).insert_data(key);
-        data_to_partition_id_.emplace(key, partition_id);
-        round_robin_counter_ = (round_robin_counter_+1) % n_partitions_;
-    }
-
-    bool mapped(T key) const {
-        return data_to_partition_id_.find(key) != data_to_partition_id_.end();
     }
 
     void repartition_data() {
+        auto start = std::chrono::steady_clock::now();
         const auto& workload_graph = pattern_tracker_.workload_graph();
         auto accesses_per_partition = pattern_tracker_.accesses_per_partition();
         auto partition_scheme = model::cut_graph(
             workload_graph,
-            data_to_partition_id_,
+            key_mapping_.data_to_partition_id(),
             accesses_per_partition,
             repartition_method_
         );
 
         auto sorted_vertex = std::move(workload_graph.sorted_vertex());
-        data_to_partition_id_ = std::unordered_map<T, int>();
+        std::unique_lock lock(mapping_mutex_);
+        mapping_epoch_++;
+        auto keys_moved = key_mapping_.assign(sorted_vertex, partition_scheme);
+        lock.unlock();
+
         pattern_tracker_.reset_accesses();
         for (auto i = 0; i < partition_scheme.size(); i++) {
-            auto partition_id = partition_scheme[i];
-            if (partition_id >= n_partitions_) {
-                printf("ERROR: partition was %d!\n", partition_id);
-                fflush(stdout);
-            }
+            auto vertice_weight = workload_graph.vertice_weight(sorted_vertex[i]);
+            pattern_tracker_.register_accesses_to_partition(
+                partition_scheme[i], vertice_weight
+            );
+        }
+
+        auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start
+        ).count();
+        n_repartitions_++;
+        last_repartition_duration_ns_ = duration;
+        total_repartition_duration_ns_ += duration;
+        last_keys_moved_ = keys_moved;
+        total_keys_moved_ += keys_moved;
+    }
 
-            auto data = sorted_vertex[i];
-            data_to_partition_id_.emplace(data, partition_id);
-            auto vertice_weight = pattern_tracker_.workload_graph().vertice_weight(data);
-            pattern_tracker_.register_accesses_to_partition(partition_id, vertice_weight);
+    int partition_core(int partition_id) const {
+        if (partition_cores_.empty()) {
+            return -1;
         }
+        return partition_cores_[partition_id % partition_cores_.size()];
     }
 
     int n_partitions_;
-    int round_robin_counter_ = 0;
-    int sync_counter_ = 0;
     int n_dispatched_requests_ = 0;
     PatternTracker<T> pattern_tracker_;
     kvstorage::Storage storage_;
     std::unordered_map<int, Partition<T>> partitions_;
-    std::unordered_map<T, int> data_to_partition_id_;
+    mutable std::shared_mutex partitions_mutex_;  // guards resizes from readers
+    KeyMapping<T> key_mapping_;
+    // only the scheduling thread writes to the mapping, under a unique
+    // lock, while plan() reads it from other threads under a shared one
+    mutable std::shared_mutex mapping_mutex_;
+    uint64_t mapping_epoch_ = 1;
 
     model::CutMethod repartition_method_;
     int repartition_interval_;
     pthread_barrier_t repartition_barrier_;
+    std::vector<int> partition_cores_;
+    int spin_budget_ = 0;
+    bool conflict_aware_sync_ = false;
+
+    std::atomic<int64_t> n_scheduled_requests_{0};
+    std::atomic<int64_t> n_cross_partition_requests_{0};
+    std::atomic<int64_t> n_repartitions_{0};
+    std::atomic<int64_t> last_repartition_duration_ns_{0};
+    std::atomic<int64_t> total_repartition_duration_ns_{0};
+    std::atomic<int64_t> last_keys_moved_{0};
+    std::atomic<int64_t> total_keys_moved_{0};
 };
 
 };
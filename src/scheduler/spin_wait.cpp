@@ -0,0 +1,42 @@
+#include "spin_wait.h"
+
+#include <stdio.h>
+
+
+namespace kvpaxos {
+
+void spin_then_wait(sem_t* semaphore, int spin_budget) {
+    for (auto i = 0; i < spin_budget; i++) {
+        if (sem_trywait(semaphore) == 0) {
+            return;
+        }
+        cpu_relax();
+    }
+    sem_wait(semaphore);
+}
+
+static bool pin(pthread_t thread, int core) {
+    if (core < 0) {
+        return false;
+    }
+
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(core, &cpu_set);
+    auto error = pthread_setaffinity_np(thread, sizeof(cpu_set_t), &cpu_set);
+    if (error != 0) {
+        printf("Failed to pin thread to core %d\n", core);
+        return false;
+    }
+    return true;
+}
+
+bool pin_to_core(std::thread& thread, int core) {
+    return pin(thread.native_handle(), core);
+}
+
+bool pin_current_thread(int core) {
+    return pin(pthread_self(), core);
+}
+
+}
@@ -0,0 +1,36 @@
+#ifndef KVPAXOS_SPIN_WAIT_H
+#define KVPAXOS_SPIN_WAIT_H
+
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+
+namespace kvpaxos {
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#endif
+}
+
+/*
+    Tries to take the semaphore spin_budget times before blocking on it, so
+    a thread that gets work shortly after running out of it doesn't pay for
+    a futex wakeup. A budget of 0 blocks right away.
+*/
+void spin_then_wait(sem_t* semaphore, int spin_budget);
+
+// binds thread to core, a negative core leaves it alone
+bool pin_to_core(std::thread& thread, int core);
+// same for the calling thread. Threads it starts afterwards inherit core
+bool pin_current_thread(int core);
+
+}
+
+#endif
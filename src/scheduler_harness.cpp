@@ -0,0 +1,184 @@
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <toml11/toml.hpp>
+#include "graph/partitioning.h"
+#include "metrics/histogram.h"
+#include "request/trace.h"
+#include "request/workload_generator.h"
+#include "scheduler/message_pool.h"
+#include "scheduler/scheduler.hpp"
+#include "types/types.h"
+
+
+struct harness_run {
+    std::vector<std::atomic<int64_t>> sent_ns;
+    std::atomic<int> n_answered{0};
+    std::atomic<bool> feeding{true};
+    std::atomic<int64_t> last_answer_ns{0};
+    metrics::Histogram latencies;
+
+    harness_run(std::size_t n_requests) : sent_ns(n_requests) {}
+};
+
+static int
+bind_reply_socket(unsigned short& port)
+{
+    auto fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (fd < 0 or bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+        printf("Failed to bind reply socket.\n");
+        exit(1);
+    }
+
+    // replies arrive in bursts far larger than the default buffer
+    int buffer_size = 64 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+    struct timeval timeout;
+    timeout.tv_sec = 1;
+    timeout.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    socklen_t length = sizeof(addr);
+    getsockname(fd, (struct sockaddr*) &addr, &length);
+    port = ntohs(addr.sin_port);
+    return fd;
+}
+
+static void
+receive_replies(int fd, harness_run& run)
+{
+    auto n_requests = run.sent_ns.size();
+    while (run.n_answered < n_requests) {
+        struct reply_message reply;
+        auto n_bytes = recv(fd, &reply, sizeof(reply), 0);
+        if (n_bytes == -1) {
+            // a second without answers after feeding means the rest
+            // were lost
+            if (not run.feeding) {
+                break;
+            }
+            continue;
+        }
+        if (reply.id < 0 or reply.id >= n_requests) {
+            continue;
+        }
+
+        auto now = workload::now_ns();
+        auto sent = run.sent_ns[reply.id].load(std::memory_order_acquire);
+        run.latencies.record(std::max<int64_t>(now - sent, 0));
+        run.last_answer_ns = now;
+        run.n_answered++;
+    }
+}
+
+static void
+run_harness(const workload::Trace& requests, int n_initial_keys,
+    int repartition_interval, int n_partitions,
+    const std::string& method_name, unsigned short port,
+    bool conflict_aware_sync)
+{
+    auto method = model::string_to_cut_method.at(method_name);
+    // partitions share their storage and counters across runs
+    model::FIRST_REPARTITION = true;
+    kvpaxos::Partition<int>::reset_shared_state();
+    kvpaxos::Scheduler<int> scheduler(
+        repartition_interval, n_partitions, method
+    );
+    scheduler.set_conflict_aware_sync(conflict_aware_sync);
+    scheduler.populate_n_initial_keys(n_initial_keys);
+    scheduler.run();
+
+    auto fd = bind_reply_socket(port);
+    harness_run run(requests.size());
+    std::thread receiver(receive_replies, fd, std::ref(run));
+
+    auto start = workload::now_ns();
+    for (auto i = 0; i < requests.size(); i++) {
+        auto command = kvpaxos::MessagePool::acquire();
+        workload::fill_command(
+            requests[i], i, *command, requests.value(i)
+        );
+        command->s_addr = htonl(INADDR_LOOPBACK);
+        command->sin_port = htons(port);
+
+        run.sent_ns[i].store(workload::now_ns(), std::memory_order_release);
+        scheduler.schedule_and_answer(command);
+    }
+    run.feeding = false;
+    receiver.join();
+    close(fd);
+
+    auto latencies = run.latencies.snapshot();
+    auto seconds = (run.last_answer_ns - start) / 1e9;
+    std::cout << method_name << "," << n_partitions << ",";
+    std::cout << requests.size() << "," << run.n_answered << ",";
+    std::cout << seconds << ",";
+    std::cout << (seconds > 0 ? run.n_answered / seconds : 0) << ",";
+    std::cout << latencies.percentile(50) << ",";
+    std::cout << latencies.percentile(99) << ",";
+    std::cout << latencies.percentile(99.9) << ",";
+    std::cout << latencies.max() << std::endl;
+}
+
+static void
+usage(std::string prog)
+{
+    std::cout << "Usage: " << prog << " config\n";
+}
+
+int
+main(int argc, char const *argv[])
+{
+    if (argc < 2) {
+        usage(std::string(argv[0]));
+        exit(1);
+    }
+
+    const auto config = toml::parse(argv[1]);
+    auto requests = workload::load_requests(config);
+    auto n_initial_keys = toml::find<int>(config, "n_initial_keys");
+    auto repartition_interval = toml::find<int>(
+        config, "repartition_interval"
+    );
+    auto partitions = toml::find_or(
+        config, "harness_partitions",
+        std::vector<int>{toml::find<int>(config, "n_partitions")}
+    );
+    auto methods = toml::find_or(
+        config, "harness_methods",
+        std::vector<std::string>{
+            toml::find<std::string>(config, "repartition_method")
+        }
+    );
+    unsigned short port = toml::find_or(config, "harness_port", 0);
+    auto conflict_aware_sync = toml::find_or(
+        config, "conflict_aware_sync", false
+    );
+
+    std::cout << "METHOD,N_PARTITIONS,REQUESTS,ANSWERED,SECONDS,";
+    std::cout << "THROUGHPUT,P50,P99,P99.9,MAX\n";
+    for (const auto& method : methods) {
+        for (auto n_partitions : partitions) {
+            run_harness(
+                requests, n_initial_keys, repartition_interval,
+                n_partitions, method, port, conflict_aware_sync
+            );
+        }
+    }
+
+    return 0;
+}
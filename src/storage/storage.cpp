@@ -7,7 +7,7 @@ std::string template_value(VALUE_SIZE, '*');
 
 std::string Storage::read(int key) const {
     try {
-        return decompress(storage_.at(key));
+        return decompress(storage_.at(key).data);
     } catch(...) {
         // I'm not sure why sometimes decompression fails.
         // It fails in what seems to be random keys and in less
@@ -17,8 +17,91 @@ std::string Storage::read(int key) const {
     }
 }
 
+std::string Storage::read(int key, ValueCache& cache) const {
+    auto it = storage_.find(key);
+    if (it == storage_.end()) {
+        return template_value;
+    }
+
+    const auto& stored = it->second;
+    const auto* cached = cache.find(key, stored.version);
+    if (cached != nullptr) {
+        return *cached;
+    }
+
+    try {
+        auto value = decompress(stored.data);
+        cache.insert(key, stored.version, value);
+        return value;
+    } catch(...) {
+        // Same as above, failed decompressions are not cached.
+        return template_value;
+    }
+}
+
+std::size_t copy_template_value(char* buffer, std::size_t capacity) {
+    auto n_bytes = std::min(template_value.size(), capacity);
+    memcpy(buffer, template_value.data(), n_bytes);
+    return n_bytes;
+}
+
+std::size_t Storage::read(int key, char* buffer, std::size_t capacity,
+    ValueCache& cache) const
+{
+    auto it = storage_.find(key);
+    if (it == storage_.end()) {
+        return copy_template_value(buffer, capacity);
+    }
+
+    const auto& stored = it->second;
+    const auto* cached = cache.find(key, stored.version);
+    if (cached != nullptr) {
+        auto n_bytes = std::min(cached->size(), capacity);
+        memcpy(buffer, cached->data(), n_bytes);
+        return n_bytes;
+    }
+
+    try {
+        auto n_bytes = decompress(stored.data, buffer, capacity);
+        cache.insert(key, stored.version, buffer, n_bytes);
+        return n_bytes;
+    } catch(...) {
+        return copy_template_value(buffer, capacity);
+    }
+}
+
 void Storage::write(int key, const std::string& value) {
-    storage_[key] = compress(value);
+    store(key, compress(value));
+}
+
+void Storage::write(int key, const std::string& value, ValueCache& cache) {
+    write(key, value);
+    cache.invalidate(key);
+}
+
+void Storage::write(int key, const char* value, std::size_t size,
+    ValueCache& cache)
+{
+    store(key, compress(value, size));
+    cache.invalidate(key);
+}
+
+void Storage::store(int key, std::string&& compressed) {
+    auto inserted = storage_.insert({key, stored_value()});
+    auto& stored = inserted.first->second;
+    auto old_size = stored.data.size();
+    stored.data = std::move(compressed);
+    stored.version++;
+
+    n_bytes_ += stored.data.size() - old_size;
+    if (inserted.second) {
+        n_bytes_ += sizeof(int) + sizeof(stored_value);
+    }
+}
+
+void Storage::clear() {
+    storage_.clear();
+    n_bytes_ = 0;
 }
 
 std::vector<std::string> Storage::scan(int start, int length) {
@@ -30,4 +113,27 @@ std::vector<std::string> Storage::scan(int start, int length) {
     return values;
 }
 
+std::size_t Storage::scan(int start, int length, char* buffer,
+    std::size_t capacity, ValueCache& cache)
+{
+    // each value is written as a frame, its length followed by its bytes,
+    // stopping early if the next value might not fit in what is left
+    std::size_t n_bytes = 0;
+    for (auto i = 0; i < length; i++) {
+        if (capacity - n_bytes < SCAN_FRAME_HEADER_SIZE + VALUE_SIZE) {
+            break;
+        }
+
+        auto key = (start + i) % storage_.size();
+        auto* frame = buffer + n_bytes;
+        uint16_t value_size = read(
+            key, frame + SCAN_FRAME_HEADER_SIZE,
+            capacity - n_bytes - SCAN_FRAME_HEADER_SIZE, cache
+        );
+        memcpy(frame, &value_size, SCAN_FRAME_HEADER_SIZE);
+        n_bytes += SCAN_FRAME_HEADER_SIZE + value_size;
+    }
+    return n_bytes;
+}
+
 };
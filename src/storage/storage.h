@@ -2,6 +2,8 @@
 #define _KVPAXOS_STORAGE_H_
 
 
+#include <algorithm>
+#include <atomic>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -10,6 +12,7 @@
 #include "constants/constants.h"
 #include "tbb/concurrent_unordered_map.h"
 #include "types/types.h"
+#include "value_cache.h"
 
 
 namespace kvstorage {
@@ -19,11 +22,32 @@ public:
     Storage() = default;
 
     std::string read(int key) const;
+    std::string read(int key, ValueCache& cache) const;
+    std::size_t read(int key, char* buffer, std::size_t capacity,
+        ValueCache& cache) const;
     void write(int key, const std::string& value);
+    void write(int key, const std::string& value, ValueCache& cache);
+    void write(int key, const char* value, std::size_t size,
+        ValueCache& cache);
     std::vector<std::string> scan(int start, int length);
+    std::size_t scan(int start, int length, char* buffer,
+        std::size_t capacity, ValueCache& cache);
+    // drops every value, no other thread may be using the storage
+    void clear();
+
+    // approximate bytes held by stored values and their entries
+    std::size_t memory_usage() const {return n_bytes_;}
 
 private:
-    tbb::concurrent_unordered_map<int, std::string> storage_;
+    struct stored_value {
+        std::string data;
+        unsigned long version{0};
+    };
+
+    void store(int key, std::string&& compressed);
+
+    tbb::concurrent_unordered_map<int, stored_value> storage_;
+    std::atomic<std::size_t> n_bytes_{0};
 };
 
 };
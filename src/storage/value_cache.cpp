@@ -0,0 +1,91 @@
+#include "value_cache.h"
+
+
+namespace kvstorage {
+
+ValueCache::ValueCache(std::size_t capacity)
+    : entries_(std::max<std::size_t>(capacity, 1))
+{
+    for (auto& entry : entries_) {
+        entry.valid = false;
+        entry.referenced = false;
+        entry.value.reserve(VALUE_SIZE);
+    }
+    key_to_entry_.reserve(entries_.size());
+}
+
+const std::string* ValueCache::find(int key, unsigned long version) {
+    auto it = key_to_entry_.find(key);
+    if (it == key_to_entry_.end()) {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    auto& entry = entries_[it->second];
+    if (entry.version != version) {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    entry.referenced = true;
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    return &entry.value;
+}
+
+void ValueCache::insert(
+    int key, unsigned long version, const std::string& value)
+{
+    insert(key, version, value.data(), value.size());
+}
+
+void ValueCache::insert(
+    int key, unsigned long version, const char* value, std::size_t size)
+{
+    auto it = key_to_entry_.find(key);
+    std::size_t index;
+    if (it != key_to_entry_.end()) {
+        index = it->second;
+    } else {
+        index = next_victim();
+        auto& victim = entries_[index];
+        if (victim.valid) {
+            key_to_entry_.erase(victim.key);
+        }
+        key_to_entry_.emplace(key, index);
+    }
+
+    auto& entry = entries_[index];
+    entry.key = key;
+    entry.version = version;
+    entry.valid = true;
+    entry.referenced = false;
+    entry.value.assign(value, size);
+}
+
+void ValueCache::invalidate(int key) {
+    auto it = key_to_entry_.find(key);
+    if (it == key_to_entry_.end()) {
+        return;
+    }
+
+    auto& entry = entries_[it->second];
+    entry.valid = false;
+    entry.referenced = false;
+    key_to_entry_.erase(it);
+}
+
+std::size_t ValueCache::next_victim() {
+    // An empty slot or one that wasn't read since the hand last passed
+    // through it is taken, referenced slots get a second chance.
+    while (true) {
+        auto& entry = entries_[clock_hand_];
+        auto index = clock_hand_;
+        clock_hand_ = (clock_hand_ + 1) % entries_.size();
+        if (not entry.valid or not entry.referenced) {
+            return index;
+        }
+        entry.referenced = false;
+    }
+}
+
+};
@@ -0,0 +1,56 @@
+#ifndef _KVPAXOS_VALUE_CACHE_H_
+#define _KVPAXOS_VALUE_CACHE_H_
+
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "constants/constants.h"
+
+
+namespace kvstorage {
+
+/*
+    Bounded cache of decompressed values, evicted with the CLOCK algorithm.
+    Each entry remembers the version of the stored value it was decompressed
+    from, so a value rewritten by another partition is never served stale.
+    A cache is meant to be owned and used by a single partition thread, only
+    the hit and miss counters may be read from other threads.
+*/
+class ValueCache {
+public:
+    ValueCache(std::size_t capacity = VALUE_CACHE_SIZE);
+
+    const std::string* find(int key, unsigned long version);
+    void insert(int key, unsigned long version, const std::string& value);
+    void insert(int key, unsigned long version,
+        const char* value, std::size_t size);
+    void invalidate(int key);
+
+    unsigned long hits() const {return hits_;}
+    unsigned long misses() const {return misses_;}
+
+private:
+    struct entry {
+        int key;
+        unsigned long version;
+        bool valid;
+        bool referenced;
+        std::string value;
+    };
+
+    std::size_t next_victim();
+
+    std::vector<entry> entries_;
+    std::unordered_map<int, std::size_t> key_to_entry_;
+    std::size_t clock_hand_{0};
+    std::atomic<unsigned long> hits_{0};
+    std::atomic<unsigned long> misses_{0};
+};
+
+};
+
+#endif
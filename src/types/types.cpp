@@ -1 +1,107 @@
 #include "types.h"
+
+
+std::size_t
+reply_message_size(const struct reply_message& reply)
+{
+	// only the used part of the answer plus its terminator goes on the wire
+	return offsetof(struct reply_message, answer) + reply.size + 1;
+}
+
+std::vector<std::string>
+scan_answer_values(const char* answer, std::size_t size)
+{
+	std::vector<std::string> values;
+	std::size_t offset = 0;
+	while (offset + SCAN_FRAME_HEADER_SIZE <= size) {
+		uint16_t value_size;
+		memcpy(&value_size, answer + offset, SCAN_FRAME_HEADER_SIZE);
+		offset += SCAN_FRAME_HEADER_SIZE;
+		if (offset + value_size > size) {
+			break;
+		}
+		values.emplace_back(answer + offset, value_size);
+		offset += value_size;
+	}
+	return values;
+}
+
+std::size_t
+encode_command(const struct command& command, char* buffer)
+{
+	struct command_header header;
+	header.version = COMMAND_ENCODING_VERSION;
+	header.type = command.type;
+	header.value_size = command.value_size;
+	header.scan_length = command.scan_length;
+	header.sin_port = command.sin_port;
+	header.s_addr = command.s_addr;
+	header.id = command.id;
+	header.key = command.key;
+
+	memcpy(buffer, &header, sizeof(header));
+	memcpy(buffer + sizeof(header), command.value, command.value_size);
+	return sizeof(header) + command.value_size;
+}
+
+std::size_t
+decode_command(const char* buffer, std::size_t size, struct command& command)
+{
+	if (size < sizeof(struct command_header)) {
+		return 0;
+	}
+
+	struct command_header header;
+	memcpy(&header, buffer, sizeof(header));
+	if (header.version != COMMAND_ENCODING_VERSION
+		or header.type > RESIZE
+		or header.value_size > VALUE_SIZE
+		or header.scan_length > MAX_SCAN_LENGTH
+		or size < sizeof(header) + header.value_size)
+	{
+		return 0;
+	}
+
+	command.id = header.id;
+	command.type = header.type;
+	command.key = header.key;
+	command.scan_length = header.scan_length;
+	command.s_addr = header.s_addr;
+	command.sin_port = header.sin_port;
+	command.value_size = header.value_size;
+	memcpy(command.value, buffer + sizeof(header), header.value_size);
+	return sizeof(header) + header.value_size;
+}
+
+std::size_t
+encode_batch_header(uint16_t n_commands, char* buffer)
+{
+	struct batch_header header;
+	header.version = BATCH_ENCODING_VERSION;
+	header.n_commands = n_commands;
+	memcpy(buffer, &header, sizeof(header));
+	return sizeof(header);
+}
+
+std::size_t
+decode_batch_header(const char* buffer, std::size_t size, uint16_t& n_commands)
+{
+	if (size < sizeof(struct batch_header)) {
+		return 0;
+	}
+
+	struct batch_header header;
+	memcpy(&header, buffer, sizeof(header));
+	if (header.version != BATCH_ENCODING_VERSION) {
+		return 0;
+	}
+
+	n_commands = header.n_commands;
+	return sizeof(header);
+}
+
+std::size_t
+batch_buffer_size(int max_commands)
+{
+	return sizeof(struct batch_header) + max_commands*MAX_ENCODED_COMMAND_SIZE;
+}
@@ -10,10 +10,16 @@
 #define _KVPAXOS_TYPES_H_
 
 
+#include <atomic>
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <mutex>
+#include <string>
+#include <string.h>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 #include <tbb/concurrent_unordered_map.h>
 
 #include <evpaxos.h>
@@ -24,28 +30,113 @@
 
 typedef std::chrono::_V2::system_clock::time_point time_point;
 
+namespace metrics {
+	class LatencyRecorder;
+}
+
 struct client_args {
     bool verbose;
     int print_percentage;
     unsigned short reply_port;
-    tbb::concurrent_unordered_map<int, time_point>* sent_timestamp;
+    unsigned long reply_address;
+    int n_listener_threads;
+    metrics::LatencyRecorder* latency_recorder;
 	std::mutex* print_mutex;
+	std::atomic<int> n_outstanding{0};
+	struct event* send_event{nullptr};
 };
 
+/*
+	SCAN answers are a sequence of frames, each made of the value's length
+	as a 16 bits integer followed by the value itself. Other answers are
+	plain null terminated strings.
+*/
+const std::size_t SCAN_FRAME_HEADER_SIZE = sizeof(uint16_t);
+
 struct reply_message {
 	int id;
-	char answer[VALUE_SIZE*MAX_SCAN_LENGTH+MAX_SCAN_LENGTH];
+	int type;
+	int size;
+	char answer[(VALUE_SIZE+SCAN_FRAME_HEADER_SIZE)*MAX_SCAN_LENGTH+1];
 };
 
+std::size_t reply_message_size(const struct reply_message& reply);
+std::vector<std::string> scan_answer_values(
+	const char* answer, std::size_t size
+);
+
 enum request_type
 {
 	READ,
 	WRITE,
 	SCAN,
 	SYNC,
-	ERROR
+	ERROR,
+	READ_INDEX,
+	RESIZE
+};
+
+/*
+	Commands are submitted to Paxos in a compact binary encoding, a fixed
+	header followed by the written value, if any. The header's first byte
+	is the encoding version, replicas refuse versions they don't know, as
+	well as unknown types and scans longer than MAX_SCAN_LENGTH.
+*/
+const uint8_t COMMAND_ENCODING_VERSION = 1;
+
+struct __attribute__((packed)) command_header {
+	uint8_t version;
+	uint8_t type;
+	uint16_t value_size;
+	uint16_t scan_length;
+	uint16_t sin_port;
+	uint32_t s_addr;
+	int32_t id;
+	int32_t key;
 };
 
+const std::size_t MAX_ENCODED_COMMAND_SIZE =
+	sizeof(struct command_header) + VALUE_SIZE;
+
+/*
+	A command as decoded by the replica. SYNC commands are never encoded,
+	they are created by the scheduler and abuse s_addr to carry a barrier.
+*/
+struct command {
+	int id;
+	int type;
+	int key;
+	int scan_length;
+	unsigned long s_addr;
+	unsigned short sin_port;
+	unsigned short value_size;
+	char value[VALUE_SIZE];
+};
+
+/*
+	A Paxos value is a batch of commands, a small header with the number of
+	commands followed by each encoded command, which is self delimited by
+	its own header.
+*/
+const uint8_t BATCH_ENCODING_VERSION = 1;
+
+struct __attribute__((packed)) batch_header {
+	uint8_t version;
+	uint16_t n_commands;
+};
+
+const std::size_t MAX_BATCH_SIZE = UINT16_MAX;
+
+std::size_t encode_command(const struct command& command, char* buffer);
+std::size_t decode_command(
+	const char* buffer, std::size_t size, struct command& command
+);
+std::size_t encode_batch_header(uint16_t n_commands, char* buffer);
+std::size_t decode_batch_header(
+	const char* buffer, std::size_t size, uint16_t& n_commands
+);
+std::size_t batch_buffer_size(int max_commands);
+
 struct stats
 {
 	long min_latency;